@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief Builds the sensor calibration file from measured points, see vd_calibration.hpp.
+ *
+ * @code
+ *     make -C host && ./host/vd_cal_gen 3 vdcal.bin < points.txt
+ * @endcode
+ *
+ * The first argument is the number of sensors, VD_IR_CHANNELS of the build the
+ * file is for.  Every line of the input is "<channel> <counts> <mm>", channel 0
+ * being the leftmost sensor, e.g. the filtered reading with a target held at a
+ * measured distance.
+ *
+ * Each table point is interpolated between the two measured points around it
+ * and held at the first or last one outside of them.  A sensor without any
+ * point keeps the nominal curve.  Copy the file to the SD card as vdcal.bin.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../vd_calibration.hpp"
+
+static const int MAX_POINTS = 256;
+static const int MAX_CHANNELS = 8;
+
+typedef struct {
+        int counts;
+        int mm;
+} calPoint;
+
+static int byCounts(const void *a, const void *b)
+{
+    return ((const calPoint*) a)->counts - ((const calPoint*) b)->counts;
+}
+
+/** @returns the distance at @param counts from the @param n sorted points @param p */
+static int interpolate(const calPoint *p, int n, int counts)
+{
+    int i;
+
+    if(counts <= p[0].counts) {
+        return p[0].mm;
+    }
+    for(i = 1; i < n; i++) {
+        if(counts <= p[i].counts) {
+            return p[i - 1].mm + (p[i].mm - p[i - 1].mm) * (counts - p[i - 1].counts) / (p[i].counts - p[i - 1].counts);
+        }
+    }
+    return p[n - 1].mm;
+}
+
+int main(int argc, char **argv)
+{
+    static calPoint points[MAX_CHANNELS][MAX_POINTS];
+    int count[MAX_CHANNELS] = { 0 };
+    vdCalibrationTable<MAX_CHANNELS> table = vdCalibration<MAX_CHANNELS>().table();
+    const int channels = (argc == 3) ? atoi(argv[1]) : 0;
+    int counts, mm, c, i;
+    FILE *f;
+
+    if(channels < 1 || channels > MAX_CHANNELS) {
+        fprintf(stderr, "usage: %s <channels, 1..%d> <output file> < points\n", argv[0], MAX_CHANNELS);
+        return 1;
+    }
+
+    while(scanf("%d %d %d", &c, &counts, &mm) == 3) {
+        if(c < 0 || c >= channels || counts < 0 || counts > 4095 || mm <= 0) {
+            fprintf(stderr, "bad point: %d %d %d\n", c, counts, mm);
+            return 1;
+        }
+        if(count[c] == MAX_POINTS) {
+            fprintf(stderr, "more than %d points for channel %d\n", MAX_POINTS, c);
+            return 1;
+        }
+        points[c][count[c]].counts = counts;
+        points[c][count[c]].mm = mm;
+        count[c]++;
+    }
+
+    for(c = 0; c < channels; c++) {
+        if(0 == count[c]) {
+            continue;
+        }
+        qsort(points[c], count[c], sizeof(calPoint), byCounts);
+        for(i = 0; i < VD_CAL_POINTS; i++) {
+            mm = interpolate(points[c], count[c], i << VD_CAL_SHIFT);
+            mm = (mm > VD_CAL_MAX_MM) ? VD_CAL_MAX_MM : (mm < VD_CAL_MIN_MM) ? VD_CAL_MIN_MM : mm;
+
+            /* noisy points must not make the curve rise, vdCalibration::load() would refuse it */
+            table.mm[c][i] = (i > 0 && mm > table.mm[c][i - 1]) ? table.mm[c][i - 1] : mm;
+        }
+        printf("%d: %d points, %d mm at 4095 counts .. %d mm at 0\n", c, count[c],
+               table.mm[c][VD_CAL_POINTS - 1], table.mm[c][0]);
+    }
+    /* the rows are in order, so the first tables are the file's, and the board is little endian too */
+    table.header.channels = channels;
+    table.header.crc = vdCrc16((const uint8_t*) table.mm, channels * sizeof(table.mm[0]));
+    if(!(f = fopen(argv[2], "wb")) || fwrite(&table.header, sizeof(table.header), 1, f) != 1 ||
+       fwrite(table.mm, sizeof(table.mm[0]), channels, f) != (size_t) channels || fclose(f) != 0) {
+        perror(argv[2]);
+        return 1;
+    }
+    return 0;
+}
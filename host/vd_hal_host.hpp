@@ -0,0 +1,201 @@
+/**
+ * @file
+ * @brief Linux backend of vd_hal.h for the host simulation, include through vd_hal.h only.
+ *
+ * Every hardware access lands in the plain variables below.  The simulator
+ * (host/vd_sim.cpp) advances simNow, fills simAdcBlock before each control tick,
+ * simDivider sample periods per scan, and reads back the PWM duties, LEDs and
+ * transmitted bytes afterwards.
+ */
+#ifndef VD_HAL_HOST_HPP_
+#define VD_HAL_HOST_HPP_
+
+#include <stdio.h>
+#include "vd_ring.hpp"
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static uint32_t simNow = 0;                         ///< Virtual clock in ms
+static vdAdcBlock simAdcBlock;
+static bool simAdcValid = false;
+static int simDivider = 1;                          ///< Sample periods per scan of the next block
+static int simPwm[VD_PWM_CHANNELS];
+static uint8_t simLeds = 0;
+static bool simBuzzer = false;
+static int simDisplay = 0;
+static uint8_t simSwitches = 0;
+static uint32_t simTxBytes = 0;
+static uint32_t simTxFrames = 0;
+static vdRing<vdBtCommand, 8> simBtRx;              ///< Commands "received" from the phone
+static bool simStandby = false;                     ///< Only recorded, the simulation keeps sampling at full rate
+static const char *simLogPath = NULL;               ///< Log files are <simLogPath>.<n>, NULL for none
+static FILE *simLogFile = NULL;
+
+static inline uint32_t vdHalTicks(void)
+{
+    return simNow;
+}
+
+static inline void vdHalCycleCounterInit(void)
+{
+}
+
+/* host cycles (TSC), or ns where there is no TSC */
+static inline uint32_t vdHalCycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return (uint32_t) __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+/* the TSC rate is measured once against the monotonic clock, 10 ms of busy wait */
+static uint32_t vdHalCyclesPerUs(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static uint32_t perUs = 0;
+    struct timespec a, b;
+    uint64_t ns;
+
+    if(0 == perUs) {
+        clock_gettime(CLOCK_MONOTONIC, &a);
+        const uint64_t start = __rdtsc();
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &b);
+            ns = (b.tv_sec - a.tv_sec) * 1000000000ULL + b.tv_nsec - a.tv_nsec;
+        } while(ns < 10000000);
+        perUs = (uint32_t)((__rdtsc() - start) * 1000 / ns);
+        perUs = perUs ? perUs : 1;
+    }
+    return perUs;
+#else
+    return 1000;
+#endif
+}
+
+static inline void vdHalDelayMs(uint32_t ms)
+{
+    /* nothing else runs on the host, so sleeping is just time passing */
+    simNow += ms;
+}
+
+static inline void vdHalSampleDivider(int divider)
+{
+    simDivider = divider;
+}
+
+static inline const vdAdcBlock* vdAdcGetBlock(void)
+{
+    return simAdcValid ? &simAdcBlock : NULL;
+}
+
+static inline void vdHalPwmSet(int channel, int percent)
+{
+    simPwm[channel] = percent;
+}
+
+static inline void vdHalLeds(uint8_t mask)
+{
+    simLeds = mask;
+}
+
+static inline void vdHalBuzzer(bool on)
+{
+    simBuzzer = on;
+}
+
+static inline void vdHalDisplay(int number)
+{
+    simDisplay = number;
+}
+
+static inline uint8_t vdHalSwitches(void)
+{
+    return simSwitches;
+}
+
+static inline bool vdBluetoothSend(const uint8_t *data, int len)
+{
+    simTxBytes += len;
+    simTxFrames++;
+    return true;
+}
+
+/* never blocks, the simulator queues commands into simBtRx before calling vdBluetoothRx() */
+static inline bool vdBluetoothGetCommand(vdBtCommand& cmd, bool wait)
+{
+    return simBtRx.pop(cmd);
+}
+
+static bool vdStorageOpen(uint32_t& generation)
+{
+    static uint32_t lastGeneration = 0;
+    char path[256];
+
+    if(simLogFile) {
+        fclose(simLogFile);
+        simLogFile = NULL;
+    }
+    if(!simLogPath) {
+        return false;
+    }
+    snprintf(path, sizeof(path), "%s.%d", simLogPath, (int)((lastGeneration + 1) % VD_LOG_FILES));
+    if(!(simLogFile = fopen(path, "wb"))) {
+        return false;
+    }
+    generation = ++lastGeneration;
+    return true;
+}
+
+static bool vdStorageWrite(uint32_t offset, const void *data, int len, bool sync)
+{
+    return simLogFile && 0 == fseek(simLogFile, offset, SEEK_SET) &&
+           fwrite(data, 1, len, simLogFile) == (size_t) len && (!sync || 0 == fflush(simLogFile));
+}
+
+/* the simulated sensors follow the nominal curve, there is nothing to calibrate */
+static bool vdStorageReadCalibration(void *data, int len)
+{
+    return false;
+}
+
+/* nothing survives a run, the tools set params directly */
+static bool vdStorageRegisterParams(int *values, const char * const *names, int count)
+{
+    return false;
+}
+
+static void vdHalStandby(bool standby)
+{
+    simStandby = standby;
+}
+
+static void vdHalStandbyWait(uint32_t ms) { }
+static void vdHalWakeUp(void) { }
+
+static const vdRamUse vdHalRamModules[] = {
+    { "adc",        sizeof(simAdcBlock) },
+    { "bluetooth",  sizeof(simBtRx) },
+};
+
+static inline int vdHalRam(const vdRamUse **modules)
+{
+    *modules = vdHalRamModules;
+    return sizeof(vdHalRamModules) / sizeof(vdHalRamModules[0]);
+}
+
+/* the simulator runs every stage itself, in order, so there is nothing to wait for or signal */
+static inline void vdAdcInit(void) { }
+static inline void vdPowerInit(void) { }
+static inline bool vdAdcWaitBlock(void) { return simAdcValid; }
+static inline void vdBluetoothInit(void) { }
+static inline void vdActuatorRegister(void) { }
+static inline void vdActuatorSignal(void) { }
+static inline bool vdActuatorWait(void) { return true; }
+
+#endif /* VD_HAL_HOST_HPP_ */
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Prints the records of flight recorder log files, from the SD card or vd_sim.
+ *
+ * @code
+ *     make -C host && ./host/vd_log_dump vdlog3.bin vdlog4.bin ...
+ * @endcode
+ *
+ * Files are printed in the order given, pass them oldest generation first.  A file
+ * is preallocated, so decoding stops at the first chunk that does not carry the
+ * generation of the file header, which is where the previous contents begin.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "../vd_recorder.hpp"
+
+static const char * const stateNames[] = { "ALARM", "STOP", "FWD", "REV", "FWD_L", "FWD_R", "REV_L", "REV_R", "TURN" };
+
+/* only the decoder is used, the time unit comes from the file and is checked against it */
+static const int PERIOD_MS = 10;
+typedef vdFlightRecorder<2, PERIOD_MS> vdDecoder;
+
+static void dumpBlock(const uint16_t *block)
+{
+    vdFlightRecord rec;
+    int pos = VD_REC_HEADER_WORDS;
+
+    memset(&rec, 0, sizeof(rec));
+    rec.timestamp = vdDecoder::blockTimestamp(block);
+    while(pos < VD_REC_BLOCK_WORDS && block[pos] != 0) {
+        pos += vdDecoder::decode(&block[pos], rec);
+        printf("%10u %4u %4u %4u %-5s %3u%s\n", rec.timestamp, rec.left, rec.middle, rec.right,
+               (rec.state < sizeof(stateNames) / sizeof(stateNames[0])) ? stateNames[rec.state] : "?", rec.speed,
+               (rec.flags & VD_REC_PAUSED) ? " paused" : "");
+    }
+}
+
+static int dumpFile(const char *path)
+{
+    uint16_t chunk[VD_LOG_CHUNK_BLOCKS][VD_REC_BLOCK_WORDS];
+    vdLogHeader header, first;
+    uint32_t lost = 0;
+    uint32_t n;
+    int i;
+    FILE *f = fopen(path, "rb");
+
+    if(!f) {
+        perror(path);
+        return 1;
+    }
+
+    for(n = 0; fread(chunk, sizeof(chunk), 1, f) == 1; n++) {
+        memcpy(&header, chunk[0], sizeof(header));
+        if(0 == n) {
+            first = header;
+            if(memcmp(header.magic, VD_LOG_MAGIC, sizeof(header.magic)) || header.blockWords != VD_REC_BLOCK_WORDS ||
+               header.periodMs != PERIOD_MS) {
+                fprintf(stderr, "%s: not a vd log file, or a different format\n", path);
+                fclose(f);
+                return 1;
+            }
+            printf("# %s: generation %u\n", path, header.generation);
+            lost = header.lost;
+        }
+        else if(memcmp(header.magic, VD_LOG_MAGIC, sizeof(header.magic)) || header.generation != first.generation ||
+                header.chunk != n) {
+            break;
+        }
+
+        if(header.lost != lost) {
+            printf("# %u blocks lost\n", header.lost - lost);
+            lost = header.lost;
+        }
+        for(i = 1; i < VD_LOG_CHUNK_BLOCKS; i++) {
+            dumpBlock(chunk[i]);
+        }
+    }
+    printf("# %s: %u chunks\n", path, n);
+
+    fclose(f);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int i, err = 0;
+
+    if(argc < 2) {
+        fprintf(stderr, "usage: %s file...\n", argv[0]);
+        return 2;
+    }
+    for(i = 1; i < argc; i++) {
+        err |= dumpFile(argv[i]);
+    }
+    return err;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @brief Host benchmark for vdRunningMedian against the old per-tick selection sort.
+ *
+ * Feeds the same pseudo-random 12-bit ADC stream into both filters, checks that
+ * every median matches, and prints cycles per update for each window length.
+ *
+ * Build and run on the workstation :
+ * @code
+ *     g++ -O2 -I.. vd_median_bench.cpp -o vd_median_bench && ./vd_median_bench
+ * @endcode
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vd_median.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static inline uint64_t cycles(void) { return __rdtsc(); }
+#else
+static inline uint64_t cycles(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec; // ns on non-x86 hosts
+}
+#endif
+
+static const int UPDATES = 200000;
+
+static uint32_t rng = 12345;
+static int adcSample(void)
+{
+    rng = rng * 1103515245 + 12345;
+    return (rng >> 16) & 0xFFF;
+}
+
+/* what vdNormalizeSensorValues() used to do for one channel */
+template <int N>
+static int sortMedian(int *queue, int &tail, int value)
+{
+    int sorted[N];
+    int i, j, big, temp;
+
+    queue[tail] = value;
+    if(++tail >= N) tail = 0;
+
+    for(i = 0; i < N; i++) sorted[i] = queue[i];
+    for(i = 0; i < N; i++) {
+        for(j = big = 0; j < (N - i); j++) {
+            if(sorted[j] > sorted[big]) big = j;
+        }
+        temp = sorted[big];
+        sorted[big] = sorted[(N - 1) - i];
+        sorted[(N - 1) - i] = temp;
+    }
+    return sorted[N / 2];
+}
+
+template <int N>
+static bool bench(void)
+{
+    static int samples[UPDATES];
+    static int queue[N];
+    int tail = 0;
+    int sink = 0;
+    vdRunningMedian<N> median;
+
+    rng = 12345;
+    for(int i = 0; i < UPDATES; i++) {
+        samples[i] = adcSample();
+    }
+
+    /* correctness against the reference, over a shorter run */
+    for(int i = 0; i < UPDATES / 10; i++) {
+        int ref = sortMedian<N>(queue, tail, samples[i]);
+        if(median.update(samples[i]) != ref) {
+            printf("QLEN %3d : mismatch at sample %d\n", N, i);
+            return false;
+        }
+    }
+
+    vdRunningMedian<N> timed;
+    uint64_t start = cycles();
+    for(int i = 0; i < UPDATES; i++) {
+        sink += timed.update(samples[i]);
+    }
+    uint64_t heapCycles = cycles() - start;
+
+    const int sortRuns = UPDATES / 20;
+    start = cycles();
+    for(int i = 0; i < sortRuns; i++) {
+        sink += sortMedian<N>(queue, tail, samples[i]);
+    }
+    uint64_t sortCycles = cycles() - start;
+
+    printf("QLEN %3d : running median %7.1f cycles/update, selection sort %9.1f cycles/update (%d)\n",
+           N, (double)heapCycles / UPDATES, (double)sortCycles / sortRuns, sink & 1);
+    return true;
+}
+
+int main(void)
+{
+    bool ok = true;
+
+    ok &= bench<15>();
+    ok &= bench<30>();
+    ok &= bench<31>();
+    ok &= bench<63>();
+    ok &= bench<127>();
+    ok &= bench<255>();
+
+    return ok ? 0 : 1;
+}
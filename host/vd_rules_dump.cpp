@@ -0,0 +1,42 @@
+/**
+ * @file
+ * @brief Prints the compile-time decision table of vd_rules.hpp as text.
+ *
+ * One line per (state, left, middle, right, beyond target) that changes something,
+ * so two versions of the rules can be reviewed with a plain diff :
+ * @code
+ *     ./vd_rules_dump > before.txt; (edit vd_rules.hpp, make); ./vd_rules_dump | diff before.txt -
+ * @endcode
+ */
+#include <stdio.h>
+#include "vd_rules.hpp"
+
+static const char * const stateNames[] = {
+    "ALARM", "STOP", "FWD", "REV", "FWD_LEFT", "FWD_RIGHT", "REV_LEFT", "REV_RIGHT", "TURN"
+};
+static const char * const zoneNames[] = { "OUT", "TOO_FAR", "FAR", "IN_RANGE", "CLOSE" };
+static const char * const speedNames[] = { "-", "SLOW", "MEDIUM", "FAST" };
+static const char * const targetNames[] = { "-", "left", "middle", "right" };
+
+int main(void)
+{
+    int s, l, m, r, b;
+
+    printf("%-9s %-8s %-8s %-8s %-6s -> %-9s %-6s %s\n", "state", "left", "middle", "right", "beyond",
+           "next", "speed", "lastTarget");
+
+    for(s = 0; s < VD_NUM_STATES; s++)
+    for(l = 0; l < VD_NUM_ZONES; l++)
+    for(m = 0; m < VD_NUM_ZONES; m++)
+    for(r = 0; r < VD_NUM_ZONES; r++)
+    for(b = 0; b < 2; b++) {
+        const uint8_t d = vdDecide(s, l, m, r, b);
+        if(VD_DECISION_STATE(d) == s && VD_DECISION_SPEED(d) == VD_KEEP_SPEED && VD_DECISION_TARGET(d) == VD_KEEP_TARGET) {
+            continue;
+        }
+        printf("%-9s %-8s %-8s %-8s %-6d -> %-9s %-6s %s\n", stateNames[s], zoneNames[l], zoneNames[m], zoneNames[r], b,
+               stateNames[VD_DECISION_STATE(d)], speedNames[VD_DECISION_SPEED(d)], targetNames[VD_DECISION_TARGET(d)]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Linux simulation of the vd control stack on a virtual clock.
+ *
+ * vd_essentials.cpp is compiled unchanged against host/vd_hal_host.hpp.  A
+ * simple world model moves a target in front of a differential-drive robot,
+ * turns the geometry into IR ADC readings, and integrates the PWM duties the
+ * control code writes back.  Every tick runs the same stages as the board:
+ * filter, decision, actuation, indication and telemetry.
+ *
+ * The run prints throughput and tracking metrics plus a hash of the state and
+ * motor outputs of every tick, so a change to the hot path can be profiled and
+ * checked for behaviour changes without a board.
+ *
+ * @code
+ *     make -C host && ./host/vd_sim [ticks] [seed] [log path]
+ * @endcode
+ *
+ * With a log path the flight recorder is stored like on the SD card, into
+ * <log path>.0 to .7, which host/vd_log_dump can decode.
+ *
+ * VD_IR_CHANNELS sensors are spread SIM_SENSOR_ANGLE apart, centred on the
+ * heading.  `make -C host bench-channels` builds and profiles 3, 5 and 8 of them.
+ */
+#define VD_HOST_SIM             1
+#include "../vd_essentials.cpp"
+
+#include "vd_world.hpp"
+#include <time.h>
+
+int main(int argc, char **argv)
+{
+    const long ticks = (argc > 1) ? atol(argv[1]) : 1000000;
+    simWorld w;
+    simMetrics m = { 0 };
+    uint32_t hash = 2166136261u;
+    int c;
+
+    simLogPath = (argc > 3) ? argv[3] : NULL;
+    simStart(&w, (argc > 2) ? atol(argv[2]) : 1);
+    m.lastState = vdState;
+
+    const clock_t begin = clock();
+    while(m.ticks < ticks) {
+        simTick(&w);
+        simMeasure(&w, &m);
+
+        hash = (hash ^ vdState) * 16777619u;
+        for(c = 0; c < VD_PWM_CHANNELS; c++) {
+            hash = (hash ^ simPwm[c]) * 16777619u;
+        }
+    }
+    const double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+
+    printf("ticks           : %ld (%.1f s of robot time)\n", m.ticks, (double) m.ticks * VD_BLOCK_LEN / VD_SAMPLE_HZ);
+    printf("sample rate     : %ld scans, %.1f %% of full rate\n", m.scans, 100.0 * m.scans / m.ticks);
+    printf("host time       : %.3f s, %.0f ticks/s\n", seconds, seconds > 0 ? m.ticks / seconds : 0.0);
+    printf("range error     : %.2f cm mean\n", m.rangeError / m.ticks);
+    printf("lost target     : %.1f %% of ticks\n", 100.0 * m.lostTicks / m.ticks);
+    printf("state changes   : %ld\n", m.stateChanges);
+    printf("motor effort    : %.1f %% mean per channel\n", m.effort / m.ticks / VD_PWM_CHANNELS);
+    printf("pwm writes      : %u, %.2f per tick\n", motorWrites, (double) motorWrites / m.ticks);
+    printf("telemetry       : %u frames, %u bytes\n", simTxFrames, simTxBytes);
+    printf("regression hash : %08x\n", hash);
+
+    /* what the flight recorder still holds at the end of the run */
+    vdFlightRecord rec, first = { 0 };
+    uint32_t lost = 0;
+    long records = 0;
+    while(flightRecorder.drain(&rec, 1, &lost)) {
+        if(0 == records++) {
+            first = rec;
+        }
+    }
+    printf("flight recorder : %ld records, last %.1f s, in %d bytes\n", records,
+           records ? (rec.timestamp - first.timestamp) / 1000.0 : 0.0, flightRecorder.size());
+    if(simLogPath) {
+        printf("log files       : %u chunks written, %u blocks lost\n", logWrites, logLost);
+    }
+
+#if VD_ENABLE_PROFILING
+    printf("\n%-10s %9s %8s %8s %8s %8s  (host cycles)\n", "stage", "count", "min", "p50", "p99", "max");
+    for(c = 0; c < VD_PROF_STAGES; c++) {
+        const vdProfileStats *s = &vdProfile[c];
+        printf("%-10s %9u %8u %8u %8u %8u\n", vdProfileStageNames[c], s->count, s->min,
+               vdProfilePercentile(s, 50), vdProfilePercentile(s, 99), s->max);
+    }
+#endif
+
+    printf("\n%-10s %9s %8s %8s  (host cycles)\n", "slot", "runs", "max", "overruns");
+    for(c = 0; c < VD_SLOTS; c++) {
+        const vdSlotStats& s = executive.stats(c);
+        printf("%-10s %9u %8u %8u\n", executive.slot(c).name, s.runs, s.maxCycles, s.overruns);
+    }
+    printf("%-10s %9u %8u %8u\n", "frame", executive.frames(), executive.maxFrameCycles(), executive.frameOverruns());
+
+    /* the same list as the vdmem command, sizes of the host build */
+    const vdRamUse *hal;
+    const int halCount = vdHalRam(&hal);
+    uint32_t ram = 0;
+    printf("\n%-12s %6s  (static RAM)\n", "module", "bytes");
+    for(c = 0; c < VD_RAM_MODULES + halCount; c++) {
+        const vdRamUse *r = (c < VD_RAM_MODULES) ? &vdRamModules[c] : &hal[c - VD_RAM_MODULES];
+        printf("%-12s %6u\n", r->name, r->bytes);
+        ram += r->bytes;
+    }
+    printf("%-12s %6u\n", "total", ram);
+
+    return 0;
+}
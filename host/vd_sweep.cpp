@@ -0,0 +1,376 @@
+/**
+ * @file
+ * @brief Parameter sweep of the vd control code in the host simulation, ranks vdParams sets.
+ *
+ * Every combination of the values in sweepAxes that vdParamsCheck() accepts is
+ * run through the world of host/vd_world.hpp with the real filter, decision and
+ * motor code, for every seed, and the configurations are ranked by sweepCost()
+ * of their mean metrics.
+ *
+ * @code
+ *     make -C host && ./host/vd_sweep [ticks] [seeds] [threads] [top]
+ * @endcode
+ *
+ * vd_essentials.cpp keeps its state in file and function statics, so a run has
+ * to start from a fresh process to be independent of the one before.  Each run
+ * is this program started again with -run and the configuration, which prints
+ * one result line.  A worker thread per core starts the runs and collects the
+ * results: every worker owns a range of the runs and takes from its front, an
+ * idle worker steals the back half of the largest range left.  The threads
+ * default to the online cores.
+ *
+ * QLEN and the other window sizes are template arguments, a build setting,
+ * and are not swept.
+ */
+#define VD_HOST_SIM             1
+#include "../vd_essentials.cpp"
+
+#include "vd_world.hpp"
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+static const int SWEEP_MAX_VALUES = 4;
+
+/* the values tried for one parameter */
+typedef struct {
+        int param;                      ///< VD_PARAM_INDEX()
+        int count;
+        int value[SWEEP_MAX_VALUES];
+} sweepAxis;
+
+static const sweepAxis sweepAxes[] = {
+    { VD_PARAM_INDEX(leftError),                4, { 5, 10, 15, 20 } },
+    { VD_PARAM_INDEX(zoneBound[2]),             3, { 220, 260, 300 } },
+    { VD_PARAM_INDEX(speed[VD_SPEED_MEDIUM]),   3, { 35, 50, 65 } },
+    { VD_PARAM_INDEX(speed[VD_SPEED_FAST]),     3, { 55, 70, 85 } },
+    { VD_PARAM_INDEX(distanceKp),               4, { 500, 1000, 1500, 2000 } },
+    { VD_PARAM_INDEX(distanceKi),               3, { 0, 20, 50 } },
+    { VD_PARAM_INDEX(distanceKd),               3, { 2500, 5000, 8000 } },
+    { VD_PARAM_INDEX(bearingKp),                3, { 30, 50, 80 } },
+    { VD_PARAM_INDEX(bearingKd),                3, { 150, 250, 400 } },
+};
+static const int SWEEP_AXES = sizeof(sweepAxes) / sizeof(sweepAxes[0]);
+
+/* weights of sweepCost(), a lost target already shows as a large range error */
+static const double SWEEP_CHURN_WEIGHT = 0.05;      ///< cm per state change per minute
+static const double SWEEP_EFFORT_WEIGHT = 0.2;      ///< cm per % mean duty
+
+/* metrics of a run, or their mean over the seeds */
+typedef struct {
+        double rangeError;      ///< cm mean
+        double lost;            ///< % of ticks
+        double churn;           ///< State changes per minute of robot time
+        double effort;          ///< % mean duty per PWM channel
+} sweepResult;
+
+static double sweepCost(const sweepResult *r)
+{
+    return r->rangeError + SWEEP_CHURN_WEIGHT * r->churn + SWEEP_EFFORT_WEIGHT * r->effort;
+}
+
+/** Decodes configuration number @param n, mixed radix over sweepAxes, into @param p */
+static void sweepConfig(long n, vdParams *p)
+{
+    int *value = (int*) p;
+    int a;
+
+    *p = VD_PARAMS_DEFAULT;
+    for(a = 0; a < SWEEP_AXES; a++) {
+        value[sweepAxes[a].param] = sweepAxes[a].value[n % sweepAxes[a].count];
+        n /= sweepAxes[a].count;
+    }
+}
+
+/** One run from power up, the child side of sweepSpawn() */
+static int sweepRunChild(long ticks, uint32_t seed)
+{
+    simWorld w;
+    simMetrics m = { 0 };
+
+    simStart(&w, seed);
+    m.lastState = vdState;
+    while(m.ticks < ticks) {
+        simTick(&w);
+        simMeasure(&w, &m);
+    }
+
+    const double minutes = (double) m.ticks * VD_BLOCK_LEN / VD_SAMPLE_HZ / 60;
+    fprintf(stdout, "result %f %f %f %f\n", m.rangeError / m.ticks, 100.0 * m.lostTicks / m.ticks,
+            m.stateChanges / minutes, m.effort / m.ticks / VD_PWM_CHANNELS);
+    return 0;
+}
+
+/* shared by the workers, set up before they start */
+static const char *sweepSelf;
+static long sweepTicks;
+static int sweepSeeds;
+static sweepResult *sweepResults;   ///< Per run, run n is configuration n / sweepSeeds with seed n % sweepSeeds + 1
+
+/** Runs @param run in a fresh process, @returns false if it did not print its result */
+static bool sweepSpawn(long run, sweepResult *r)
+{
+    vdParams p;
+    char arg[3 + VD_PARAMS_COUNT][16];
+    char *argv[5 + VD_PARAMS_COUNT];
+    char line[256];
+    int fd[2], status, i, n = 0;
+    pid_t pid;
+    posix_spawn_file_actions_t actions;
+
+    sweepConfig(run / sweepSeeds, &p);
+    argv[0] = (char*) sweepSelf;
+    argv[1] = (char*) "-run";
+    snprintf(arg[0], sizeof(arg[0]), "%ld", sweepTicks);
+    snprintf(arg[1], sizeof(arg[1]), "%ld", run % sweepSeeds + 1);
+    for(i = 0; i < VD_PARAMS_COUNT; i++) {
+        snprintf(arg[2 + i], sizeof(arg[2 + i]), "%d", ((const int*) &p)[i]);
+    }
+    for(i = 0; i < 2 + VD_PARAMS_COUNT; i++) {
+        argv[2 + i] = arg[i];
+    }
+    argv[4 + VD_PARAMS_COUNT] = NULL;
+
+    if(pipe(fd) != 0) {
+        return false;
+    }
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fd[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fd[0]);
+    posix_spawn_file_actions_addclose(&actions, fd[1]);
+    status = posix_spawn(&pid, sweepSelf, &actions, NULL, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fd[1]);
+    if(status != 0) {
+        close(fd[0]);
+        return false;
+    }
+
+    /* the vd code may print too, the result is the line of its own */
+    FILE *f = fdopen(fd[0], "r");
+    while(f && fgets(line, sizeof(line), f)) {
+        if(n < 4) {
+            n = sscanf(line, "result %lf %lf %lf %lf", &r->rangeError, &r->lost, &r->churn, &r->effort);
+        }
+    }
+    if(f) {
+        fclose(f);
+    }
+    else {
+        close(fd[0]);
+    }
+    waitpid(pid, &status, 0);
+
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return false;
+    }
+    return (n == 4);
+}
+
+/* the runs [head, tail) a worker has not started yet */
+typedef struct {
+        pthread_mutex_t lock;
+        long head;
+        long tail;
+} sweepQueue;
+
+static sweepQueue *sweepQueues;
+static int sweepWorkers;
+
+/** @returns the next run for worker @param self in @param run, stealing when its own range is empty */
+static bool sweepTake(int self, long *run)
+{
+    sweepQueue *q = &sweepQueues[self];
+    long head, tail;
+    int i, victim;
+
+    pthread_mutex_lock(&q->lock);
+    if(q->head < q->tail) {
+        *run = q->head++;
+        pthread_mutex_unlock(&q->lock);
+        return true;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    for(;;) {
+        /* the largest range left, read without locks since it is only a hint */
+        victim = -1;
+        for(i = 0, tail = 0; i < sweepWorkers; i++) {
+            if(sweepQueues[i].tail - sweepQueues[i].head > tail) {
+                tail = sweepQueues[i].tail - sweepQueues[i].head;
+                victim = i;
+            }
+        }
+        if(victim < 0) {
+            return false;
+        }
+
+        sweepQueue *v = &sweepQueues[victim];
+        pthread_mutex_lock(&v->lock);
+        if(v->head >= v->tail) {
+            pthread_mutex_unlock(&v->lock);
+            continue;
+        }
+        head = v->tail - (v->tail - v->head + 1) / 2;
+        tail = v->tail;
+        v->tail = head;
+        pthread_mutex_unlock(&v->lock);
+
+        /* nobody steals from an empty range, so nobody touched ours meanwhile */
+        pthread_mutex_lock(&q->lock);
+        *run = head;
+        q->head = head + 1;
+        q->tail = tail;
+        pthread_mutex_unlock(&q->lock);
+        return true;
+    }
+}
+
+static void *sweepWorker(void *arg)
+{
+    const int self = (int)(intptr_t) arg;
+    long run;
+
+    vdParams p;
+
+    while(sweepTake(self, &run)) {
+        /* sets the vd code would not accept from the terminal are not run */
+        sweepConfig(run / sweepSeeds, &p);
+        if(vdParamsCheck(&p) >= 0) {
+            continue;
+        }
+        if(!sweepSpawn(run, &sweepResults[run])) {
+            fprintf(stderr, "run %ld failed\n", run);
+            sweepResults[run].rangeError = 1e9;
+        }
+    }
+    return NULL;
+}
+
+/* a configuration and its mean over the seeds, for sorting */
+typedef struct {
+        long config;
+        sweepResult mean;
+        double cost;
+} sweepRank;
+
+static int byCost(const void *a, const void *b)
+{
+    const double d = ((const sweepRank*) a)->cost - ((const sweepRank*) b)->cost;
+    return (d < 0) ? -1 : (d > 0) ? 1 : 0;
+}
+
+static void sweepPrint(int rank, const sweepRank *r)
+{
+    vdParams p;
+    int a;
+
+    sweepConfig(r->config, &p);
+    printf("%5d %7.1f %8.1f %6.1f %6.1f %6.1f ", rank, r->cost, r->mean.rangeError, r->mean.lost, r->mean.churn,
+           r->mean.effort);
+    for(a = 0; a < SWEEP_AXES; a++) {
+        printf(" %*d", (int) strlen(vdParamNames[sweepAxes[a].param]), ((const int*) &p)[sweepAxes[a].param]);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    long configs = 1, c, run;
+    int a, i, top;
+
+    if(argc == 4 + VD_PARAMS_COUNT && 0 == strcmp(argv[1], "-run")) {
+        for(i = 0; i < VD_PARAMS_COUNT; i++) {
+            ((int*) &paramsSaved)[i] = atoi(argv[4 + i]);
+        }
+        return sweepRunChild(atol(argv[2]), atol(argv[3]));
+    }
+
+    sweepTicks = (argc > 1) ? atol(argv[1]) : 12000;
+    sweepSeeds = (argc > 2) ? atoi(argv[2]) : 2;
+    sweepWorkers = (argc > 3) ? atoi(argv[3]) : (int) sysconf(_SC_NPROCESSORS_ONLN);
+    top = (argc > 4) ? atoi(argv[4]) : 20;
+    sweepSelf = "/proc/self/exe";     // this very binary, wherever it was started from
+    if(sweepTicks < 1 || sweepSeeds < 1 || sweepWorkers < 1 || top < 1) {
+        fprintf(stderr, "usage: %s [ticks] [seeds] [threads] [top]\n", argv[0]);
+        return 1;
+    }
+
+    for(a = 0; a < SWEEP_AXES; a++) {
+        configs *= sweepAxes[a].count;
+    }
+    const long runs = configs * sweepSeeds;
+    sweepResults = (sweepResult*) calloc(runs, sizeof(sweepResult));
+    sweepQueues = (sweepQueue*) calloc(sweepWorkers, sizeof(sweepQueue));
+    pthread_t *threads = (pthread_t*) calloc(sweepWorkers, sizeof(pthread_t));
+    sweepRank *ranks = (sweepRank*) calloc(configs, sizeof(sweepRank));
+    if(!sweepResults || !sweepQueues || !threads || !ranks) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("%ld configurations x %d seeds, %ld ticks (%.0f s of robot time) each, %d threads\n", configs, sweepSeeds,
+           sweepTicks, (double) sweepTicks * VD_BLOCK_LEN / VD_SAMPLE_HZ, sweepWorkers);
+    fflush(stdout);
+
+    const time_t begin = time(NULL);
+    for(i = 0; i < sweepWorkers; i++) {
+        pthread_mutex_init(&sweepQueues[i].lock, NULL);
+        sweepQueues[i].head = runs * i / sweepWorkers;
+        sweepQueues[i].tail = runs * (i + 1) / sweepWorkers;
+    }
+    for(i = 0; i < sweepWorkers; i++) {
+        if(pthread_create(&threads[i], NULL, sweepWorker, (void*)(intptr_t) i) != 0) {
+            fprintf(stderr, "cannot start worker %d\n", i);
+            return 1;
+        }
+    }
+    for(i = 0; i < sweepWorkers; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    /* mean over the seeds, and where the hand-tuned values would be */
+    long defaultConfig = -1, ranked = 0;
+    for(c = 0; c < configs; c++) {
+        vdParams p;
+        sweepRank *r = &ranks[ranked];
+
+        sweepConfig(c, &p);
+        if(vdParamsCheck(&p) >= 0) {
+            continue;
+        }
+        ranked++;
+        r->config = c;
+        for(run = c * sweepSeeds; run < (c + 1) * sweepSeeds; run++) {
+            r->mean.rangeError += sweepResults[run].rangeError / sweepSeeds;
+            r->mean.lost += sweepResults[run].lost / sweepSeeds;
+            r->mean.churn += sweepResults[run].churn / sweepSeeds;
+            r->mean.effort += sweepResults[run].effort / sweepSeeds;
+        }
+        r->cost = sweepCost(&r->mean);
+        if(0 == memcmp(&p, &VD_PARAMS_DEFAULT, sizeof(p))) {
+            defaultConfig = c;
+        }
+    }
+    qsort(ranks, ranked, sizeof(sweepRank), byCost);
+
+    printf("done in %ld s, %ld configurations out of range skipped\n\n%5s %7s %8s %6s %6s %6s ", (long)(time(NULL) - begin), configs - ranked, "rank", "cost", "error cm",
+           "lost %", "churn", "effort");
+    for(a = 0; a < SWEEP_AXES; a++) {
+        printf(" %s", vdParamNames[sweepAxes[a].param]);
+    }
+    printf("\n");
+    for(c = 0; c < ranked; c++) {
+        if(c < top) {
+            sweepPrint(c + 1, &ranks[c]);
+        }
+        else if(ranks[c].config == defaultConfig) {
+            printf("  ...\n");
+            sweepPrint(c + 1, &ranks[c]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ * @file
+ * @brief World model of the host simulation: a target wandering in front of a differential-drive robot.
+ *
+ * Turns the geometry into IR ADC readings, integrates the PWM duties the vd code
+ * writes back, and runs a frame of the vd cyclic executive once per tick.  A
+ * tick spans simDivider full-rate ticks when the vd code lowered the sample rate.
+ * Include after vd_essentials.cpp built with VD_HOST_SIM, see host/vd_sim.cpp.
+ */
+#ifndef VD_WORLD_HPP_
+#define VD_WORLD_HPP_
+
+#include <stdlib.h>
+#include <math.h>
+
+static const double SIM_PI = 3.14159265358979323846;
+/* between two neighbouring sensors, an even count has none on the heading so they are packed closer to cover it */
+static const double SIM_SENSOR_ANGLE = ((VD_CHANNELS & 1) ? 25.0 : 20.0) * SIM_PI / 180;
+static const double SIM_BEAM_HALF = 12.0 * SIM_PI / 180;       ///< Half width of an IR beam
+static const double SIM_MAX_RANGE = 150.0;                     ///< cm
+static const double SIM_WHEEL_BASE = 15.0;                     ///< cm
+static const double SIM_CM_PER_PERCENT = 0.5;                  ///< Wheel speed (cm/s) per % of duty
+static const double SIM_LEFT_GAIN = 70.0 / 85.0;               ///< Left motor is weaker, hence vdParams::leftError
+static const double SIM_TARGET_RANGE = 18.0;                   ///< Range where the middle sensor reads ~1100
+
+typedef struct {
+        double x, y, heading;       ///< Robot pose, cm and rad
+        double tx, ty, theading;    ///< Target position and heading
+        double t;                   ///< Seconds since start
+        uint32_t rng;
+} simWorld;
+
+static int simNoise(simWorld *w, int amplitude)
+{
+    w->rng = w->rng * 1103515245 + 12345;
+    return (int)((w->rng >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/** Sharp-style IR response, the reading rises as the target gets closer */
+static uint16_t simSense(simWorld *w, double axis)
+{
+    const double dx = w->tx - w->x;
+    const double dy = w->ty - w->y;
+    const double range = sqrt(dx * dx + dy * dy);
+    double off = atan2(dy, dx) - (w->heading + axis);
+    int adc;
+
+    while(off > SIM_PI) off -= 2 * SIM_PI;
+    while(off < -SIM_PI) off += 2 * SIM_PI;
+
+    if(fabs(off) < SIM_BEAM_HALF && range < SIM_MAX_RANGE) {
+        adc = (int)(24000.0 / (range + 4.0)) + simNoise(w, 30);
+    }
+    else {
+        adc = 120 + simNoise(w, 40);
+    }
+
+    return (adc < 0) ? 0 : (adc > 4095) ? 4095 : adc;
+}
+
+static void simStep(simWorld *w, double dt)
+{
+    /* target wanders at a slow walk and stops now and then */
+    w->t += dt;
+    w->theading = 0.6 * sin(0.2 * w->t) + 0.3 * sin(0.53 * w->t);
+    const double tspeed = 10.0 * fmax(0.0, sin(0.15 * w->t));
+    w->tx += tspeed * cos(w->theading) * dt;
+    w->ty += tspeed * sin(w->theading) * dt;
+
+    /* differential drive from the duties vd_essentials.cpp wrote */
+    const double vl = (simPwm[VD_PWM_LEFT_FWD] - simPwm[VD_PWM_LEFT_REV]) * SIM_CM_PER_PERCENT * SIM_LEFT_GAIN;
+    const double vr = (simPwm[VD_PWM_RIGHT_FWD] - simPwm[VD_PWM_RIGHT_REV]) * SIM_CM_PER_PERCENT;
+    const double v = (vl + vr) / 2;
+    w->heading += (vr - vl) / SIM_WHEEL_BASE * dt;
+    w->x += v * cos(w->heading) * dt;
+    w->y += v * sin(w->heading) * dt;
+}
+
+static void simTick(simWorld *w)
+{
+    const double dt = 1.0 / VD_SAMPLE_HZ;
+    const int divider = simDivider;
+    int i, p, c;
+
+    for(i = 0; i < VD_BLOCK_LEN; i++) {
+        /* the world moves every sample period, the sensors are only scanned at the end of the last one */
+        for(p = 0; p < divider; p++) {
+            simStep(w, dt);
+        }
+        /* channel 0 is the leftmost, at the largest angle counter-clockwise from the heading */
+        for(c = 0; c < VD_CHANNELS; c++) {
+            simAdcBlock.channel[c][i] = simSense(w, ((VD_CHANNELS - 1) / 2.0 - c) * SIM_SENSOR_ANGLE);
+        }
+        simNow += divider * 1000 / VD_SAMPLE_HZ;
+    }
+    simAdcBlock.divider = divider;
+    simAdcValid = true;
+
+    /* one frame of the cyclic executive, the pipeline tasks on the board run in the same order */
+    vdExecutiveFrame(vdAdcWaitBlock());
+    vdLogger();
+    vdReportNotices();
+}
+
+/** What vdExecutiveTask does on the board before its first frame, see tasks.hpp */
+static void simBoot(void)
+{
+    vdBluetoothInit();
+    vdAdcInit();
+    vdProfileInit();
+    vdPowerInit();
+    vdExecutiveInit();
+    vdParamsRegister();
+    vdCalibrationLoad();
+    vdParamsLoad();
+}
+
+/**
+ * Starts a run from @param seed: boots with paramsSaved like the board does,
+ * lets the filters fill while paused, then sends the start command like the phone app
+ */
+static void simStart(simWorld *w, uint32_t seed)
+{
+    const simWorld start = { 0, 0, 0, SIM_TARGET_RANGE, 0, 0, 0, seed };
+    int i;
+
+    *w = start;
+    simBoot();
+    for(i = 0; i < QLEN; i++) {
+        w->t = 0;
+        simTick(w);
+    }
+    vdBtCommand cmd = { 1, { VD_BT_CMD_START } };
+    simBtRx.push(cmd);
+}
+
+/**
+ * What a run is judged on, summed over the ticks by simMeasure(), lastState
+ * starts at vdState.  Everything but the counts is weighted by the full-rate
+ * ticks a tick spans, so the means are per full-rate tick at any sample rate.
+ */
+typedef struct {
+        long ticks;             ///< Full-rate ticks, robot time
+        long scans;             ///< simTick() calls
+        double rangeError;      ///< cm
+        long lostTicks;         ///< Target out of sensor range
+        long stateChanges;
+        double effort;          ///< % duty summed over the PWM channels
+        int lastState;
+} simMetrics;
+
+static void simMeasure(const simWorld *w, simMetrics *m)
+{
+    const double dx = w->tx - w->x, dy = w->ty - w->y;
+    const double range = sqrt(dx * dx + dy * dy);
+    const int weight = simAdcBlock.divider;
+    int c;
+
+    m->ticks += weight;
+    m->scans++;
+    m->rangeError += weight * fabs(range - SIM_TARGET_RANGE);
+    m->lostTicks += weight * (range > SIM_MAX_RANGE);
+    if(vdState != m->lastState) {
+        m->stateChanges++;
+        m->lastState = vdState;
+    }
+    for(c = 0; c < VD_PWM_CHANNELS; c++) {
+        m->effort += weight * simPwm[c];
+    }
+}
+
+#endif /* VD_WORLD_HPP_ */
@@ -45,11 +45,37 @@
  */
 int main(void)
 {
-    scheduler_add_task(new vdStartupTask(PRIORITY_MEDIUM));
-    scheduler_add_task(new vdSensorTask(PRIORITY_MEDIUM));
-    scheduler_add_task(new vdMotorTask(PRIORITY_MEDIUM));
+#if VD_CYCLIC_EXECUTIVE
+    /**
+     * One task runs the vd stages in a fixed order once per block of samples,
+     * 2 KB of stack instead of 7 KB over six tasks.  The SD logger keeps a task
+     * of its own since a card write can take longer than a frame.  Above the
+     * terminal task for the reason given below.
+     */
+    scheduler_add_task(new vdExecutiveTask(PRIORITY_HIGH));
+    scheduler_add_task(new vdLoggerTask(PRIORITY_LOW));
+#else
+    /**
+     * The vd control path is a pipeline: the ADC ISR wakes vdSensorTask, which
+     * filters and decides and then notifies vdMotorTask.  Priorities follow the
+     * deadlines, actuation first and indication/telemetry last.
+     *
+     * The two control tasks run strictly above the terminal task: a long vdlog
+     * or vdprof dump would otherwise share time slices with them and hold a
+     * decision back by a tick or more while the wheels keep their last duty.
+     * CRITICAL stays reserved to the wireless task, so they take HIGH and the
+     * terminal task moves down to MEDIUM.  They block on the ADC ISR and take
+     * well under 1 ms of every 10 ms sample period, so the terminal is only
+     * delayed by that much.
+     */
+    scheduler_add_task(new vdMotorTask(PRIORITY_HIGH));
+    scheduler_add_task(new vdSensorTask(PRIORITY_HIGH));
     scheduler_add_task(new vdBluetoothRxTask(PRIORITY_MEDIUM));
-    scheduler_add_task(new vdBluetoothTxTask(PRIORITY_MEDIUM));
+    scheduler_add_task(new vdStartupTask(PRIORITY_MEDIUM));
+    scheduler_add_task(new vdIndicatorTask(PRIORITY_LOW));
+    scheduler_add_task(new vdBluetoothTxTask(PRIORITY_LOW));
+    scheduler_add_task(new vdLoggerTask(PRIORITY_LOW));
+#endif
 
     /**
      * A few basic tasks for this bare-bone system :
@@ -61,7 +87,7 @@ int main(void)
      * such that it can save remote control codes to non-volatile memory.  IR remote
      * control codes can be learned by typing "learn" command.
      */
-    scheduler_add_task(new terminalTask(PRIORITY_HIGH));
+    scheduler_add_task(new terminalTask(PRIORITY_MEDIUM));    // below the vd control tasks, see above
     scheduler_add_task(new remoteTask  (PRIORITY_LOW));
 
     /* Consumes very little CPU, but need highest priority to handle mesh network ACKs */
@@ -124,14 +124,14 @@ class vdStartupTask : public scheduler_task
 {
     public:
         vdStartupTask(uint8_t priority) :
-            scheduler_task("vdStartup", 1024, priority)
+            scheduler_task("vdStartup", VD_STACK_STARTUP, priority)
         {
         }
 
         bool run(void *p)
         {
             vdCheckButtons();
-            delay_ms(10);
+            vdIdle(10, VD_STANDBY_BUTTON_MS);
 
             return true;
         }
@@ -141,21 +141,38 @@ class vdSensorTask : public scheduler_task
 {
     public:
         vdSensorTask(uint8_t priority) :
-            scheduler_task("vdSensor", 2048, priority)
+            scheduler_task("vdSensor", VD_STACK_SENSOR, priority)
         {
-            /* left */
-            LPC_PINCON->PINSEL3 |= (3 << 28); // ADC-4 is on P1.30, select this as ADC0.4
-            /* middle */
-            LPC_PINCON->PINSEL3 |= (3 << 30); // ADC-5 is on P1.31, select this as ADC0.5
-            /* right*/
-            LPC_PINCON->PINSEL1 |= (1 << 20); // ADC-3 is on P0.26, select this as ADC0.3
+            /* muxes the sensor pins, TIMER2 paces the ADC burst scans from here on */
+            vdAdcInit();
+            vdProfileInit();
+            vdPowerInit();
+        }
+
+        bool regTlm(void)
+        {
+            /* the saved vd parameters are disk telemetry */
+            return vdParamsRegister();
+        }
+
+        bool taskEntry(void)
+        {
+            /* the SD card is only usable once the scheduler runs, the disk telemetry is restored by then */
+            vdCalibrationLoad();
+            vdParamsLoad();
+            return true;
         }
 
         bool run(void *p)
         {
-            vdNormalizeSensorValues();
+            /* sleeps until the ADC ISR hands over a full block of samples */
+            if(vdAdcWaitBlock()) {
+                vdNormalizeSensorValues();
+            }
             vdReadSensor();
-            delay_ms(10);
+
+            /* hand the decision straight to the motor task instead of letting it poll */
+            vdActuatorSignal();
 
             return true;
         }
@@ -163,10 +180,38 @@ class vdSensorTask : public scheduler_task
 
 class vdMotorTask : public scheduler_task
 {
-        static const uint32_t buzzerBit = (1 << 23);
     public:
         vdMotorTask(uint8_t priority) :
-            scheduler_task("vdMotor", 1024, priority)
+            scheduler_task("vdMotor", VD_STACK_MOTOR, priority)
+        {
+        }
+
+        bool taskEntry(void)
+        {
+            vdActuatorRegister();
+            return true;
+        }
+
+        bool run(void *p)
+        {
+            /* wakes up as soon as vdSensorTask has made a decision */
+            vdActuatorWait();
+            vdRunMotor();
+
+            return true;
+        }
+};
+
+/**
+ * Plays the LED and buzzer pattern of the current state.  Runs at low priority
+ * so LED animation can never hold up the motor task.
+ */
+class vdIndicatorTask : public scheduler_task
+{
+        static const uint32_t buzzerBit = (1 << 23);
+    public:
+        vdIndicatorTask(uint8_t priority) :
+            scheduler_task("vdIndicator", VD_STACK_INDICATOR, priority)
         {
             /* configure P1.23 as o/p for buzzer */
             LPC_GPIO1->FIODIR |=  buzzerBit;
@@ -177,10 +222,8 @@ class vdMotorTask : public scheduler_task
 
         bool run(void *p)
         {
-            vdRunMotor();
             vdIndicatorLED();
-            vdBuzzer();
-            delay_ms(10);
+            vdIdle(10, 0);  // dark in standby, nothing to play until the dog wakes up
 
             return true;
         }
@@ -190,30 +233,15 @@ class vdBluetoothRxTask : public scheduler_task
 {
     public:
         vdBluetoothRxTask(uint8_t priority) :
-            scheduler_task("vdBluetoothRx", 1024, priority)
+            scheduler_task("vdBluetoothRx", VD_STACK_BT_RX, priority)
         {
-            LPC_SC->PCONP &= ~(1 <<24 );
-            LPC_SC->PCONP |= (1 <<24 );         //UART 2 power/clock control bit.
-
-            LPC_SC->PCLKSEL1 &= ~(3 <<16);
-            LPC_SC->PCLKSEL1 |=  (1 <<16);      //Peripheral clock selection for uart2
-
-            LPC_PINCON->PINSEL4 &= ~(0xF << 16);    //uart2
-            LPC_PINCON->PINSEL4 |= (0xA << 16);
-            // LPC_PINCON->PINSEL4 |= (2 << 16);
-
-            LPC_UART2->LCR = (1 << 7);
-            LPC_UART2->DLM = 0;
-
-            LPC_UART2->DLL = (sys_get_cpu_clock()) / ((16 * 115200) + 0.5);
-            //printf("System get cpu clock   %u" , sys_get_cpu_clock() );
-            LPC_UART2->LCR = 3;
+            /* UART2 at 115200, received bytes are framed by its ISR from here on */
+            vdBluetoothInit();
         }
 
         bool run(void *p)
         {
             vdBluetoothRx();
-            delay_ms(10);
 
             return true;
         }
@@ -223,7 +251,7 @@ class vdBluetoothTxTask : public scheduler_task
 {
     public:
         vdBluetoothTxTask(uint8_t priority) :
-            scheduler_task("vdBluetoothTx", 1024, priority)
+            scheduler_task("vdBluetoothTx", VD_STACK_BT_TX, priority)
         {
 #if 0
             LPC_SC->PCONP &= ~(1 <<24 );
@@ -248,7 +276,73 @@ class vdBluetoothTxTask : public scheduler_task
         bool run(void *p)
         {
             vdBluetoothTx();
-            //delay_ms(300);
+            vdIdle(10, 0);  // no readings to send in standby
+
+            return true;
+        }
+};
+
+/**
+ * Streams the flight recorder to the SD card.  Runs at low priority and only
+ * copies blocks the sensor task has finished, so a slow card can never hold
+ * up the control path.  Prints the messages the control path noted too.
+ */
+class vdLoggerTask : public scheduler_task
+{
+    public:
+        vdLoggerTask(uint8_t priority) :
+            scheduler_task("vdLogger", VD_STACK_LOGGER, priority)
+        {
+        }
+
+        bool run(void *p)
+        {
+            vdLogger();
+            vdReportNotices();
+            vdIdle(100, 1000);
+
+            return true;
+        }
+};
+
+/**
+ * The cyclic executive, runs every vd stage but the SD logger as the fixed-order
+ * slots of one task when VD_CYCLIC_EXECUTIVE is set, see vd_executive.hpp.  A
+ * frame per block of samples, so it follows the sample rate into standby.
+ */
+class vdExecutiveTask : public scheduler_task
+{
+        static const uint32_t buzzerBit = (1 << 23);
+    public:
+        vdExecutiveTask(uint8_t priority) :
+            scheduler_task("vdExecutive", VD_STACK_EXECUTIVE, priority)
+        {
+            LPC_GPIO1->FIODIR |=  buzzerBit;
+            LPC_GPIO1->FIOCLR = buzzerBit;
+
+            vdBluetoothInit();
+            vdAdcInit();
+            vdProfileInit();
+            vdPowerInit();
+            vdExecutiveInit();
+        }
+
+        bool regTlm(void)
+        {
+            return vdParamsRegister();
+        }
+
+        bool taskEntry(void)
+        {
+            vdCalibrationLoad();
+            vdParamsLoad();
+            return true;
+        }
+
+        bool run(void *p)
+        {
+            /* the ADC ISR paces the frames, a timeout still runs one without new samples */
+            vdExecutiveFrame(vdAdcWaitBlock());
 
             return true;
         }
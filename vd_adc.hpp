@@ -0,0 +1,231 @@
+/**
+ * @file
+ * @brief Timer-driven ADC0 burst acquisition for the IR sensors.
+ *
+ * TIMER2 fires every sample period and turns on BURST mode, which converts the
+ * ADC0 inputs in vdAdcChannelMap back to back, in ascending input order.  The
+ * conversion-done interrupt of the highest input (the last of the scan) stops
+ * the burst and stores every result into the row of its sensor in a
+ * double-buffered block.  When a block is full the buffers are swapped and
+ * vdSensorTask is woken up to filter the whole block.
+ *
+ * TIMER2 fires every adcDivider sample periods.  A new divider is only applied
+ * by the timer ISR at the match of the last scan of a block, right after the
+ * match reset the counter, so MR0 is never moved under a running period and
+ * every scan of a block stands for the same number of periods.
+ *
+ * In standby (vdAdcStandby()) TIMER2 only fires every VD_STANDBY_PERIOD_MS and
+ * the ADC is powered up for each scan and gated off again once it is done.
+ *
+ * The LPC17xx has eight ADC0 inputs, but AD0.6 and AD0.7 share P0.3 and P0.2
+ * with UART0, which the terminal uses, so six sensors can be wired directly.
+ *
+ * @warning Burst mode owns ADC0 once vdAdcInit() is called, so adc0_get_reading()
+ *          must not be used by other tasks (light sensor etc.) at the same time.
+ *
+ * Part of the SJOne backend, include through vd_hal.h only.
+ */
+#ifndef VD_ADC_HPP_
+#define VD_ADC_HPP_
+
+#include "LPC17xx.h"
+#include "lpc_isr.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+
+/* ADC0 input of every sensor from the leftmost one, VD_CHANNELS of them (pins are muxed by vdAdcInit()) */
+static const uint8_t vdAdcChannelMap[] = { 4, 5, 3 };
+typedef char vdAdcChannelMapCheck[(sizeof(vdAdcChannelMap) == VD_CHANNELS) ? 1 : -1];
+
+/* pin of every ADC0 input: PINSEL register, bit position and function */
+static const struct {
+        uint8_t reg;
+        uint8_t shift;
+        uint8_t function;
+} vdAdcPins[8] = {
+    { 1, 14, 1 },   // AD0.0 P0.23
+    { 1, 16, 1 },   // AD0.1 P0.24
+    { 1, 18, 1 },   // AD0.2 P0.25
+    { 1, 20, 1 },   // AD0.3 P0.26
+    { 3, 28, 3 },   // AD0.4 P1.30
+    { 3, 30, 3 },   // AD0.5 P1.31
+    { 0, 6, 2 },    // AD0.6 P0.3, UART0 RXD
+    { 0, 4, 2 },    // AD0.7 P0.2, UART0 TXD
+};
+
+static vdAdcBlock adcBlock[2];
+static volatile int adcFill = 0;        ///< Block being filled by the ISR
+static volatile int adcIndex = 0;       ///< Next sample in the block being filled
+static volatile int adcReady = -1;      ///< Last completed block, -1 if none yet
+static volatile uint32_t adcOverruns = 0;
+static SemaphoreHandle_t adcBlockSem = 0;
+static volatile int adcDivider = 1;     ///< Sample periods between two scans, TIMER2 MR0
+static volatile int adcDividerNext = 1; ///< Applied by the timer ISR at the end of the block
+static volatile int adcRunDivider = 1;  ///< Set by vdHalSampleDivider(), restored when leaving standby
+static volatile int adcScanDivider = 1; ///< Periods the scan under way stands for
+static uint32_t adcPeriodClocks = 0;    ///< TIMER2 counts per sample period
+static volatile bool adcGated = false;  ///< Standby, the ADC clock is only on during a scan
+
+static inline uint16_t vdAdcResult(uint32_t reg)
+{
+    return (reg >> 4) & 0xFFF;
+}
+
+static void vdAdcTimerISR(void)
+{
+    LPC_TIM2->IR = (1 << 0);            // clear MR0 interrupt
+    adcScanDivider = adcDivider;
+    if(adcIndex == VD_BLOCK_LEN - 1 && adcDividerNext != adcDivider) {
+        adcDivider = adcDividerNext;
+        LPC_TIM2->MR0 = adcDivider * adcPeriodClocks - 1;
+    }
+    if(adcGated) {
+        LPC_SC->PCONP |= (1 << 12);     // clock first, then out of power down
+        LPC_ADC->ADCR |= (1 << 21);
+    }
+    LPC_ADC->ADCR |= (1 << 16);         // BURST: scan the selected channels
+}
+
+static void vdAdcDoneISR(void)
+{
+    BaseType_t woken = pdFALSE;
+    vdAdcBlock *b = &adcBlock[adcFill];
+    const volatile uint32_t *data = &LPC_ADC->ADDR0;   // ADDR0..ADDR7 are consecutive
+    int c;
+
+    LPC_ADC->ADCR &= ~(1 << 16);        // one scan per timer period
+
+    /* reading the data registers also clears their DONE bits */
+    if(0 == adcIndex) {
+        b->divider = adcScanDivider;
+    }
+    for(c = 0; c < VD_CHANNELS; c++) {
+        b->channel[c][adcIndex] = vdAdcResult(data[vdAdcChannelMap[c]]);
+    }
+    if(adcGated) {
+        LPC_ADC->ADCR &= ~(1 << 21);    // power down, then stop the clock
+        LPC_SC->PCONP &= ~(1 << 12);
+    }
+
+    if(++adcIndex >= VD_BLOCK_LEN) {
+        adcReady = adcFill;
+        /* semaphore still given means vdSensorTask never picked up the previous block */
+        if(xSemaphoreGiveFromISR(adcBlockSem, &woken) != pdTRUE) {
+            adcOverruns++;
+        }
+        adcFill ^= 1;
+        adcIndex = 0;
+    }
+
+    portYIELD_FROM_ISR(woken);
+}
+
+static void vdAdcInit(void)
+{
+    const uint32_t irqPriority = VD_IRQ_PRIORITY;
+    uint32_t select = 0;
+    int last = 0;
+    int c;
+
+    adcBlockSem = xSemaphoreCreateBinary();
+
+    /* route the pin of every mapped input to the ADC */
+    for(c = 0; c < VD_CHANNELS; c++) {
+        const int input = vdAdcChannelMap[c];
+        volatile uint32_t *pinsel = &LPC_PINCON->PINSEL0 + vdAdcPins[input].reg;
+
+        *pinsel = (*pinsel & ~(3 << vdAdcPins[input].shift)) | (vdAdcPins[input].function << vdAdcPins[input].shift);
+        select |= (1 << input);
+        last = (input > last) ? input : last;
+    }
+
+    /* ADC0: select the sensor inputs, software start, power up (CLKDIV from adc0_init()) */
+    LPC_SC->PCONP |= (1 << 12);
+    LPC_ADC->ADCR &= ~((0xFF << 0) | (1 << 16) | (7 << 24));
+    LPC_ADC->ADCR |= select | (1 << 21);
+    LPC_ADC->ADINTEN = (1 << last);     // the highest input is the last of the scan
+
+    /* TIMER2 at CCLK, interrupt and reset on MR0 once per sample period */
+    LPC_SC->PCONP |= (1 << 22);
+    LPC_SC->PCLKSEL1 &= ~(3 << 12);
+    LPC_SC->PCLKSEL1 |=  (1 << 12);
+    LPC_TIM2->TCR = (1 << 1);
+    LPC_TIM2->PR = 0;
+    adcPeriodClocks = sys_get_cpu_clock() / VD_SAMPLE_HZ;
+    LPC_TIM2->MR0 = adcDivider * adcPeriodClocks - 1;
+    LPC_TIM2->MCR = (1 << 0) | (1 << 1);
+    LPC_TIM2->IR = 0x3F;
+
+    isr_register(ADC_IRQn, vdAdcDoneISR);
+    isr_register(TIMER2_IRQn, vdAdcTimerISR);
+    NVIC_SetPriority(ADC_IRQn, irqPriority);
+    NVIC_SetPriority(TIMER2_IRQn, irqPriority);
+    NVIC_EnableIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(TIMER2_IRQn);
+
+    LPC_TIM2->TCR = (1 << 0);
+}
+
+/** Scans every @param divider sample periods from the next block on, only recorded in standby */
+static void vdHalSampleDivider(int divider)
+{
+    adcRunDivider = divider;
+    if(!adcGated) {
+        adcDividerNext = divider;
+    }
+}
+
+/**
+ * Starts the next scan right away instead of at the end of the period.  The
+ * scan still stands for a whole period, only used to wake up, when the readings
+ * are refilled anyway.
+ */
+static void vdAdcKick(void)
+{
+    LPC_TIM2->TC = LPC_TIM2->MR0 - 1;
+}
+
+/** Scans every VD_STANDBY_PERIOD_MS with the ADC gated in between if @param standby, else at the vdHalSampleDivider() rate */
+static void vdAdcStandby(bool standby)
+{
+    NVIC_DisableIRQ(TIMER2_IRQn);
+    NVIC_DisableIRQ(ADC_IRQn);
+
+    adcDividerNext = standby ? VD_STANDBY_DIVIDER : adcRunDivider;
+    adcGated = standby;
+    if(!standby) {
+        LPC_SC->PCONP |= (1 << 12);     // it may have been gated between two heartbeat scans
+        LPC_ADC->ADCR |= (1 << 21);
+    }
+
+    NVIC_EnableIRQ(ADC_IRQn);
+    NVIC_EnableIRQ(TIMER2_IRQn);
+
+    if(!standby) {
+        vdAdcKick();                    // else the heartbeat period under way runs out first
+    }
+}
+
+/** @returns how long the vd tasks wait for the next block before they run anyway */
+static inline TickType_t vdAdcTimeout(void)
+{
+    const int divider = (adcDividerNext > adcDivider) ? adcDividerNext : adcDivider;
+    return (divider * VD_BLOCK_LEN * 1000 / VD_SAMPLE_HZ + VD_ADC_TIMEOUT_MS) / portTICK_PERIOD_MS;
+}
+
+/**
+ * Blocks until the ISR has completed a block of samples, or one period plus VD_ADC_TIMEOUT_MS
+ * @returns true if a new block is available through vdAdcGetBlock()
+ */
+static bool vdAdcWaitBlock(void)
+{
+    return xSemaphoreTake(adcBlockSem, vdAdcTimeout()) == pdTRUE;
+}
+
+static inline const vdAdcBlock* vdAdcGetBlock(void)
+{
+    const int ready = adcReady;
+    return (ready < 0) ? NULL : &adcBlock[ready];
+}
+
+#endif /* VD_ADC_HPP_ */
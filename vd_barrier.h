@@ -0,0 +1,7 @@
+#ifndef VD_BARRIER_H__
+#define VD_BARRIER_H__
+
+/* orders memory accesses between tasks and ISRs for the lock-free vd structures */
+#define vdMemoryBarrier()       __sync_synchronize()
+
+#endif
@@ -0,0 +1,223 @@
+/**
+ * @file
+ * @brief Interrupt-driven receive and transmit paths of the UART2 Bluetooth link.
+ *
+ * The UART2 ISR drains the RX FIFO and runs every byte through a small frame
+ * parser.  Only frames with a valid checksum are pushed into a lock-free ring,
+ * and only then is vdBluetoothRxTask woken up, so line noise can never change
+ * the state of the dog.  The cyclic executive polls the ring once a frame instead.
+ *
+ * Frame layout :
+ * @code
+ *     | 0xA5 | len | cmd | data[len - 1] | chk |
+ * @endcode
+ * len counts cmd and data (1 to VD_BT_MAX_PAYLOAD), and chk is chosen such that
+ * the 8-bit sum of len, cmd, data and chk is zero.
+ *
+ * Outgoing bytes are queued by vdBluetoothSend() and moved into the 16-byte
+ * TX FIFO by the THRE interrupt, so the sender never waits on the UART.
+ *
+ * Part of the SJOne backend, include through vd_hal.h only.
+ */
+#ifndef VD_BLUETOOTH_HPP_
+#define VD_BLUETOOTH_HPP_
+
+#include "LPC17xx.h"
+#include "lpc_isr.h"
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "vd_ring.hpp"
+
+static const uint8_t VD_BT_SYNC = 0xA5;
+
+static vdRing<vdBtCommand, 8> btRxRing;
+static SemaphoreHandle_t btRxSem = 0;
+static volatile uint32_t btRxBadFrames = 0;
+static volatile uint32_t btRxDropped = 0;
+
+static vdRing<uint8_t, 128> btTxRing;
+static volatile uint32_t btTxDropped = 0;
+static const int VD_UART_FIFO_LEN = 16;
+
+/**
+ * Feeds one received byte to the frame parser (ISR context)
+ * @returns true if it completed a valid frame that was queued
+ */
+static bool vdBtParse(uint8_t byte)
+{
+    static enum { WAIT_SYNC, WAIT_LEN, WAIT_PAYLOAD, WAIT_CHECKSUM } state = WAIT_SYNC;
+    static vdBtCommand cmd;
+    static uint8_t index, sum;
+    bool queued = false;
+
+    switch(state) {
+        case WAIT_SYNC:
+            if(VD_BT_SYNC == byte) {
+                state = WAIT_LEN;
+            }
+            break;
+
+        case WAIT_LEN:
+            if(byte >= 1 && byte <= VD_BT_MAX_PAYLOAD) {
+                cmd.len = byte;
+                sum = byte;
+                index = 0;
+                state = WAIT_PAYLOAD;
+            }
+            else {
+                btRxBadFrames++;
+                state = (VD_BT_SYNC == byte) ? WAIT_LEN : WAIT_SYNC;
+            }
+            break;
+
+        case WAIT_PAYLOAD:
+            cmd.payload[index++] = byte;
+            sum += byte;
+            if(index >= cmd.len) {
+                state = WAIT_CHECKSUM;
+            }
+            break;
+
+        case WAIT_CHECKSUM:
+            if(0 == (uint8_t)(sum + byte)) {
+                if(btRxRing.push(cmd)) {
+                    queued = true;
+                }
+                else {
+                    btRxDropped++;
+                }
+            }
+            else {
+                btRxBadFrames++;
+            }
+            state = WAIT_SYNC;
+            break;
+    }
+
+    return queued;
+}
+
+/**
+ * Moves queued bytes into the empty TX FIFO, and turns off the THRE interrupt
+ * once nothing is left.  Called from the ISR or with UART2_IRQn masked.
+ */
+static void vdBtTxFill(void)
+{
+    uint8_t byte;
+    int room = VD_UART_FIFO_LEN;
+
+    while(room-- > 0 && btTxRing.pop(byte)) {
+        LPC_UART2->THR = byte;
+    }
+    if(btTxRing.isEmpty()) {
+        LPC_UART2->IER &= ~(1 << 1);
+    }
+}
+
+static void vdBluetoothISR(void)
+{
+    BaseType_t woken = pdFALSE;
+    bool queued = false;
+    uint32_t iir;
+
+    /* bit 0 of IIR is 0 while an interrupt is pending */
+    while(!((iir = LPC_UART2->IIR) & (1 << 0))) {
+        switch((iir >> 1) & 0x7) {
+            case 0x1: // THR empty
+                vdBtTxFill();
+                break;
+
+            case 0x3: // receive line status, reading LSR clears it
+                (void) LPC_UART2->LSR;
+                break;
+
+            case 0x2: // receive data available
+            case 0x6: // character time-out
+                while(LPC_UART2->LSR & (1 << 0)) {
+                    queued |= vdBtParse(LPC_UART2->RBR);
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if(queued) {
+        xSemaphoreGiveFromISR(btRxSem, &woken);
+    }
+    portYIELD_FROM_ISR(woken);
+}
+
+/** Powers UART2 at 115200 8N1 on P2.8/P2.9, and enables its FIFOs and RX interrupt */
+static void vdBluetoothInit(void)
+{
+    btRxSem = xSemaphoreCreateBinary();
+
+    LPC_SC->PCONP &= ~(1 <<24 );
+    LPC_SC->PCONP |= (1 <<24 );         //UART 2 power/clock control bit.
+
+    LPC_SC->PCLKSEL1 &= ~(3 <<16);
+    LPC_SC->PCLKSEL1 |=  (1 <<16);      //Peripheral clock selection for uart2
+
+    LPC_PINCON->PINSEL4 &= ~(0xF << 16);    //uart2
+    LPC_PINCON->PINSEL4 |= (0xA << 16);
+
+    LPC_UART2->LCR = (1 << 7);
+    LPC_UART2->DLM = 0;
+    LPC_UART2->DLL = (sys_get_cpu_clock()) / ((16 * 115200) + 0.5);
+    LPC_UART2->LCR = 3;
+
+    LPC_UART2->FCR = (1 << 0) | (1 << 1) | (1 << 2) | (2 << 6); // reset FIFOs, RX trigger at 8 bytes
+    LPC_UART2->IER = (1 << 0) | (1 << 2);                       // RX data and line status
+
+    isr_register(UART2_IRQn, vdBluetoothISR);
+    NVIC_SetPriority(UART2_IRQn, VD_IRQ_PRIORITY);
+    NVIC_EnableIRQ(UART2_IRQn);
+}
+
+/**
+ * Blocks until the ISR has queued at least one complete command if @param wait
+ * @returns true with the oldest command in @param cmd
+ */
+static bool vdBluetoothGetCommand(vdBtCommand& cmd, bool wait)
+{
+    while(!btRxRing.pop(cmd)) {
+        if(!wait || xSemaphoreTake(btRxSem, portMAX_DELAY) != pdTRUE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Queues @param len bytes of @param data for transmission, never blocks
+ * @returns false if the TX queue had no room and nothing was queued
+ */
+static bool vdBluetoothSend(const uint8_t *data, int len)
+{
+    int i;
+
+    /* whole frames or nothing, a partial frame would only confuse the receiver */
+    if(btTxRing.space() < (uint32_t) len) {
+        btTxDropped++;
+        return false;
+    }
+    for(i = 0; i < len; i++) {
+        btTxRing.push(data[i]);
+    }
+
+    /* the ISR is the only other consumer of btTxRing, keep it out while priming the FIFO */
+    NVIC_DisableIRQ(UART2_IRQn);
+    if(LPC_UART2->LSR & (1 << 5)) {
+        vdBtTxFill();
+    }
+    if(!btTxRing.isEmpty()) {
+        LPC_UART2->IER |= (1 << 1);
+    }
+    NVIC_EnableIRQ(UART2_IRQn);
+
+    return true;
+}
+
+#endif /* VD_BLUETOOTH_HPP_ */
@@ -0,0 +1,157 @@
+/**
+ * @file
+ * @brief IR sensor calibration, ADC counts to millimetres by table lookup.
+ *
+ * The Sharp IR sensors answer roughly K / (distance + offset), so equal steps
+ * in counts are very unequal steps in distance.  Each sensor gets a table of the
+ * distance at every VD_CAL_STEP counts, and a reading is interpolated linearly
+ * between the two points around it: one shift, one mask and one multiply, no
+ * divide and no float.
+ *
+ * The nominal table is computed by the compiler from the datasheet-like curve
+ * below and lives in flash.  A per-sensor calibration file on the SD card, made
+ * by host/vd_cal_gen from measured points, replaces it at boot.
+ */
+#ifndef VD_CALIBRATION_HPP_
+#define VD_CALIBRATION_HPP_
+
+#include <stdint.h>
+#include <string.h>
+#include "vd_telemetry.hpp"
+
+static const int VD_CAL_SHIFT = 6;                              ///< log2 of the counts between two points
+static const int VD_CAL_STEP = 1 << VD_CAL_SHIFT;
+static const int VD_CAL_POINTS = (4096 >> VD_CAL_SHIFT) + 1;    ///< The last point is 4096, past any 12-bit reading
+static const int VD_CAL_MIN_MM = 60;                            ///< Closer than this the response folds back
+static const int VD_CAL_MAX_MM = 1000;                          ///< Further than this a reading is noise
+
+/* nominal response, counts = VD_CAL_K / (mm + VD_CAL_OFFSET) */
+static const int VD_CAL_K = 240000;
+static const int VD_CAL_OFFSET = 40;
+
+#define VD_CAL_MAGIC            "VDCL"
+
+/** Distance of the nominal curve at @param COUNTS, clamped to the usable range */
+template <int COUNTS>
+struct vdCalNominal
+{
+    enum {
+        mm = VD_CAL_K / (COUNTS > 0 ? COUNTS : 1) - VD_CAL_OFFSET,
+        value = (mm > VD_CAL_MAX_MM) ? VD_CAL_MAX_MM : (mm < VD_CAL_MIN_MM) ? VD_CAL_MIN_MM : mm
+    };
+};
+
+#define VD_CAL_N(i)             vdCalNominal<(i) << VD_CAL_SHIFT>::value
+#define VD_CAL_N8(i)            VD_CAL_N(i), VD_CAL_N(i + 1), VD_CAL_N(i + 2), VD_CAL_N(i + 3), \
+                                VD_CAL_N(i + 4), VD_CAL_N(i + 5), VD_CAL_N(i + 6), VD_CAL_N(i + 7)
+
+static const uint16_t vdCalNominalTable[VD_CAL_POINTS] = {
+    VD_CAL_N8(0),  VD_CAL_N8(8),  VD_CAL_N8(16), VD_CAL_N8(24),
+    VD_CAL_N8(32), VD_CAL_N8(40), VD_CAL_N8(48), VD_CAL_N8(56),
+    VD_CAL_N(64)
+};
+
+#undef VD_CAL_N8
+#undef VD_CAL_N
+
+/** Start of the calibration file (little endian), one table per channel follows */
+typedef struct {
+        char magic[4];              ///< VD_CAL_MAGIC
+        uint16_t points;            ///< VD_CAL_POINTS, a file made for another step is refused
+        uint16_t channels;          ///< A file made for another number of sensors is refused
+        uint16_t crc;               ///< CRC-16/CCITT of the tables
+} vdCalibrationHeader;
+
+/** Calibration of CHANNELS sensors, laid out like the calibration file */
+template <int CHANNELS>
+struct vdCalibrationTable
+{
+        vdCalibrationHeader header;
+        uint16_t mm[CHANNELS][VD_CAL_POINTS];   ///< Distance at every VD_CAL_STEP counts, not increasing
+};
+
+template <int CHANNELS>
+class vdCalibration
+{
+    public:
+        /** Starts out with the nominal curve for every sensor */
+        vdCalibration()
+        {
+            reset();
+        }
+
+        /** Goes back to the nominal curve for every sensor */
+        void reset(void)
+        {
+            memcpy(mTable.header.magic, VD_CAL_MAGIC, sizeof(mTable.header.magic));
+            mTable.header.points = VD_CAL_POINTS;
+            mTable.header.channels = CHANNELS;
+            for(int c = 0; c < CHANNELS; c++) {
+                memcpy(mTable.mm[c], vdCalNominalTable, sizeof(vdCalNominalTable));
+            }
+            mTable.header.crc = vdCrc16((const uint8_t*) mTable.mm, sizeof(mTable.mm));
+        }
+
+        /**
+         * Replaces the tables with @param table if it is intact and every curve
+         * falls as the counts rise, so that filtering before the conversion is
+         * still valid.  @returns false and keeps the current tables otherwise.
+         */
+        bool load(const vdCalibrationTable<CHANNELS>& table)
+        {
+            if(!valid(table)) {
+                return false;
+            }
+            mTable = table;
+            return true;
+        }
+
+        /**
+         * The tables themselves, to read a calibration file into without a second
+         * copy, only while nothing converts.  check() must follow.
+         */
+        inline vdCalibrationTable<CHANNELS>& buffer(void) { return mTable; }
+
+        /** Keeps what was read into buffer() if load() would take it, @returns false and resets otherwise */
+        bool check(void)
+        {
+            if(!valid(mTable)) {
+                reset();
+                return false;
+            }
+            return true;
+        }
+
+        /** @returns the distance in mm of 12-bit reading @param counts of sensor @param channel */
+        inline int toMm(int channel, int counts) const
+        {
+            const uint16_t *p = &mTable.mm[channel][counts >> VD_CAL_SHIFT];
+            const int frac = counts & (VD_CAL_STEP - 1);
+
+            return p[0] - (((p[0] - p[1]) * frac) >> VD_CAL_SHIFT);
+        }
+
+        inline const vdCalibrationTable<CHANNELS>& table(void) const { return mTable; }
+
+    private:
+        static bool valid(const vdCalibrationTable<CHANNELS>& table)
+        {
+            if(0 != memcmp(table.header.magic, VD_CAL_MAGIC, sizeof(table.header.magic)) ||
+               VD_CAL_POINTS != table.header.points || CHANNELS != table.header.channels ||
+               table.header.crc != vdCrc16((const uint8_t*) table.mm, sizeof(table.mm))) {
+                return false;
+            }
+            for(int c = 0; c < CHANNELS; c++) {
+                for(int i = 1; i < VD_CAL_POINTS; i++) {
+                    if(table.mm[c][i] > table.mm[c][i - 1]) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        vdCalibrationTable<CHANNELS> mTable;
+};
+
+#endif /* VD_CALIBRATION_HPP_ */
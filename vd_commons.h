@@ -1,13 +1,80 @@
 #ifndef __VD_COMMONS_H__
 #define __VD_COMMONS_H__
 
+#include <stdint.h>
+#include "vd_barrier.h"
+
+/* NVIC priority for the vd ISRs, low enough to call FreeRTOS FromISR() functions */
+#define VD_IRQ_PRIORITY         ((configMAX_SYSCALL_INTERRUPT_PRIORITY >> (8 - __NVIC_PRIO_BITS)) + 1)
+
+
+/* switch poll period of vdCheckButtons() in standby, the switches on port 1 cannot interrupt */
+#define VD_STANDBY_BUTTON_MS    50
+
+/* 1 runs the vd stages as the slots of one vdExecutiveTask (vd_executive.hpp) instead of a task each */
+#ifndef VD_CYCLIC_EXECUTIVE
+#define VD_CYCLIC_EXECUTIVE     0
+#endif
+
+/*
+ * 1 keeps the vd samples and readings in the narrowest types that hold them.  The
+ * host build with profiling goes from 8116 to 6310 bytes of vd static RAM, 22 %
+ * less; the flight recorder, most of what is left, keeps its history.  'vdmem'
+ * shows the bytes by module.
+ */
+#ifndef VD_COMPACT_LAYOUT
+#define VD_COMPACT_LAYOUT       0
+#endif
+
+/* stack bytes of the vd tasks (tasks.hpp), 'vdmem' prints how much of each has been used */
+#define VD_STACK_STARTUP        1024
+#define VD_STACK_SENSOR         2048
+#define VD_STACK_MOTOR          1024
+#define VD_STACK_INDICATOR      1024
+#define VD_STACK_BT_RX          1024
+#define VD_STACK_BT_TX          1024
+#define VD_STACK_LOGGER         2048
+#define VD_STACK_EXECUTIVE      2048
+
+static void vdAdcInit(void);
+static void vdPowerInit(void);
+static void vdProfileInit(void);
+static bool vdAdcWaitBlock(void);
 static void vdCheckButtons(void);
+static void vdCalibrationLoad(void);
+static bool vdParamsRegister(void);
+static void vdParamsLoad(void);
 static void vdNormalizeSensorValues(void);
 static void vdReadSensor(void);
+static void vdActuatorRegister(void);
+static void vdActuatorSignal(void);
+static bool vdActuatorWait(void);
 static void vdRunMotor(void);
 static void vdIndicatorLED(void);
-static void vdBuzzer(void);
+static void vdBluetoothInit(void);
 static void vdBluetoothRx(void);
 static void vdBluetoothTx(void);
+static void vdLogger(void);
+static void vdReportNotices(void);
+static void vdIdle(uint32_t runMs, uint32_t standbyMs);
+static void vdExecutiveInit(void);
+static void vdExecutiveFrame(bool fresh);
+
+#ifdef CMD_HANDLER_FUNC
+/**
+ * vd terminal commands (vd_terminal.hpp), registered in terminalTask::taskEntry() with :
+ * @code
+ *     cp.addHandler(vdProfileHandler, "vdprof", "'vdprof' : vd stage cycles, task CPU and executive slots; 'vdprof reset' : clear them");
+ *     cp.addHandler(vdLogHandler,     "vdlog",  "'vdlog' : dump the vd flight recorder since the last vdlog; 'vdlog sd' : SD logger status");
+ *     cp.addHandler(vdParamHandler,   "vdparam", "'vdparam' : vd parameters; 'vdparam <name> <value> ...' : set them; "
+ *                                                "'vdparam save' : keep them across power cycles; 'vdparam default'");
+ *     cp.addHandler(vdMemHandler,     "vdmem",  "'vdmem' : vd task stack high-water marks and recommended sizes, static RAM by module, heap");
+ * @endcode
+ */
+CMD_HANDLER_FUNC(vdProfileHandler);
+CMD_HANDLER_FUNC(vdLogHandler);
+CMD_HANDLER_FUNC(vdParamHandler);
+CMD_HANDLER_FUNC(vdMemHandler);
+#endif
 
 #endif
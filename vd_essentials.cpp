@@ -1,589 +1,1042 @@
 #include <stdio.h>
 #include <string.h>
-#include "io.hpp"
-#include "utilities.h"
-#include "adc0.h"
-#include "lpc_pwm.hpp"
 #include "vd_commons.h"
+#include "vd_hal.h"
+#include "vd_filter.hpp"
+#include "vd_snapshot.hpp"
+#include "vd_telemetry.hpp"
+#include "vd_rules.hpp"
+#include "vd_profile.hpp"
+#include "vd_recorder.hpp"
+#include "vd_pid.hpp"
+#include "vd_tracker.hpp"
+#include "vd_calibration.hpp"
+#include "vd_params.hpp"
+#include "vd_motor.hpp"
+#include "vd_rate.hpp"
+#include "vd_executive.hpp"
 //#include <math.h>
 
 #define ENABLE_DEBUG            0
 #define printf(fmt, ...)        printf("[%3d] "fmt, __LINE__, ##__VA_ARGS__);
 
-#define ZONE_CONVERT(d)         (d / 100)
-#define ZONE_OUT_OF_RANGE(d)    (ZONE_CONVERT(d) < 3)
-#define ZONE_TOO_FAR(d)         (ZONE_CONVERT(d) < 5  && ZONE_CONVERT(d) >= 3)
-#define ZONE_FAR(d)             (ZONE_CONVERT(d) < 8  && ZONE_CONVERT(d) >= 5)
-#define ZONE_IN_RANGE(d)        (ZONE_CONVERT(d) >= 8 && ZONE_CONVERT(d) <= 15)
-#define ZONE_CLOSE(d)           (ZONE_CONVERT(d) > 15)
-
 static const int QLEN = 30;
-static const int LOGLEN = 600;
-static const int VD_LEFT_ERROR = 15;
-static const int VD_RIGHT_ERROR = 0;
-static const int VD_THRESHOLD = 600;
+static const int VD_THRESHOLD = 100;    ///< mm
+static const int VD_TRACK_FLOOR = 760;  ///< Distances beyond this do not see the target, see VD_ZONE_TOO_FAR
+static const int VD_TRACK_COAST = 20;   ///< Samples the tracker predicts on after losing the target
+
+/* adaptive sample rate, see vd_rate.hpp */
+static const int VD_RATE_MAX_DIVIDER = 4;       ///< 25 Hz, about the refresh rate of the IR sensors
+static const int VD_RATE_HOLD = 50;             ///< Calm sample periods before the rate halves
+static const int VD_RATE_CALM_RANGE = 50;       ///< mm/s, the target is standing still below this
+static const int VD_RATE_CALM_BEARING = 300;    ///< Per second, of a span of 2 * VD_BEARING_SPAN
+
+/*
+ * Types of the stored samples and readings.  The compact layout keeps the filter
+ * windows as 12-bit counts in 16 bits, and the distances (never past
+ * VD_CAL_MAX_MM) and the bearing (within VD_BEARING_SPAN) in 16 bits as well.
+ * The rates stay int, a bearing jump can pass 32767 per second.
+ */
+#if VD_COMPACT_LAYOUT
+typedef uint16_t vdCounts;
+typedef uint8_t vdWindowIndex;
+typedef int16_t vdMm;
+typedef uint8_t vdPeriods;
+#else
+typedef int vdCounts;
+typedef uint16_t vdWindowIndex;
+typedef int vdMm;
+typedef int vdPeriods;
+#endif
 
-static struct {
-        int leftValue;
-        int middleValue;
-        int rightValue;
+typedef struct {
+        uint32_t timestamp; ///< Tick count when the sample block completed
+        vdMm distance[VD_CHANNELS]; ///< Filtered distance of every sensor in mm, see vd_calibration.hpp
+        vdMm leftValue;     ///< Nearest distance left of, in the middle of and right of the heading
+        vdMm middleValue;
+        vdMm rightValue;
+        vdMm range;         ///< Tracker estimates, valid while tracking, see vd_tracker.hpp
+        vdMm bearing;
+        int rangeRate;      ///< mm per second
+        int bearingRate;
+        vdPeriods periods;  ///< Sample periods since the previous reading
+        bool tracking;
         //char leftValid:1;
         //char middleValid:1;
         //char rightValid:1;
-} sensor;
+} vdSensorReading;
+
+/* the middle group is the centre sensor, or the two centre ones for an even count */
+static const int VD_MIDDLE_FIRST = (VD_CHANNELS - 1) / 2;
+static const int VD_MIDDLE_LAST = VD_CHANNELS / 2;
+typedef char vdChannelCountCheck[(VD_CHANNELS >= 3) ? 1 : -1];
+
+/* ADC counts to mm for each sensor, the nominal curve until vdCalibrationLoad() */
+static vdCalibration<VD_CHANNELS> calibration;
+
+/* published once per sample block by vdNormalizeSensorValues(), read by every other vd task */
+static vdSnapshot<vdSensorReading> sensorSnapshot;
+
+/* picks the sample rate after every decision, see vdRateBusy() */
+static vdRateGovernor<VD_RATE_MAX_DIVIDER, VD_RATE_HOLD> rateGovernor;
 
 /* logging related variables */
-static int rec[LOGLEN][6];
-static int ri = 0;
-static int pi = 0;
+static const int VD_REC_BLOCKS = 56;    ///< 3.5 KB, about 25 s of history while tracking steadily
+static vdFlightRecorder<VD_REC_BLOCKS, 1000 / VD_SAMPLE_HZ> flightRecorder;
+
+#if VD_COMPACT_LAYOUT
+/* the flight recorder block on its way to storage, vdLogger() writes the chunk one block at a time */
+static uint16_t logBlock[VD_REC_BLOCK_WORDS];
+#else
+/* flight recorder blocks on their way to storage, block 0 is where the vdLogHeader goes */
+static uint16_t logChunk[VD_LOG_CHUNK_BLOCKS][VD_REC_BLOCK_WORDS];
+#endif
+static const uint32_t VD_LOG_CHUNK_BYTES = VD_LOG_CHUNK_BLOCKS * VD_REC_BLOCK_WORDS * sizeof(uint16_t);
+static int logFill = 1;                 ///< Block of the chunk to store next, block 0 is the header
+static uint32_t logSeq = 1;             ///< Next recorder block to store
+static uint32_t logGeneration = 0;      ///< Log file being written, 0 while none is open
+static uint32_t logChunkIndex = 0;
+static uint32_t logLost = 0;            ///< Blocks overwritten or dropped before they were stored
+static uint32_t logWrites = 0;
+static uint32_t logMaxWriteMs = 0;
+
+/* the compact layout keeps the state machine and the flags below in bytes, every value fits */
+#if VD_COMPACT_LAYOUT
+typedef uint8_t vdStateVar;
+typedef uint8_t vdFlag;
+#else
+typedef vdStateId vdStateVar;
+typedef int vdFlag;
+#endif
+
 static char pEnable = 0;
-static char sEnable = 0;
 
-static int paused = 1; // when VD starts, it should start in paused mode
-static int startBT = 0;
+static vdFlag paused = 1; // when VD starts, it should start in paused mode
+static vdFlag startBT = 0;
+
+/* power modes, vdPowerUpdate() is the only one to change them */
+enum vdPowerMode {
+    VD_POWER_RUN,           ///< Full sample rate, paused or not
+    VD_POWER_STANDBY,       ///< Paused for VD_STANDBY_DELAY_MS, see vdHalStandby()
+    VD_POWER_WAKING         ///< Back at full rate, the filters refill before a resume is checked
+};
+static const uint32_t VD_STANDBY_DELAY_MS = 5000;   ///< Paused this long, the dog goes to standby
+static volatile int powerMode = VD_POWER_RUN;
+
+/* who asked to resume while paused, served by vdPowerUpdate() in the sensor task */
+enum {
+    VD_RESUME_SWITCH = (1 << 0),
+    VD_RESUME_BT = (1 << 1)
+};
+static volatile uint8_t resumeRequest = 0;
+
+/* state machine related variables, see vd_rules.hpp */
+static vdStateVar vdState;
+
+/*
+ * tuned values, see vd_params.hpp.  The control path reads params as plain
+ * variables: other tasks publish a whole new set with vdParamsPublish() and
+ * vdParamsSwap() copies it over between two ticks, so a tick never sees half of it.
+ */
+static vdParams params = VD_PARAMS_DEFAULT;
+static vdSnapshot<vdParams, 2> paramsNext;          ///< Double buffer, the terminal task is the only writer
+static vdParams paramsSaved = VD_PARAMS_DEFAULT;    ///< Disk telemetry, terminalTask saves it when it changes
+
+static int targetDist = VD_PARAMS_DEFAULT.targetDist;
+static int lastTarget;
 
-/* state machine related variables */
-static enum {
-    VD_ALARM,
-    VD_STOP,
-    VD_FWD,
-    VD_REV,
-    VD_FWD_LEFT,
-    VD_FWD_RIGHT,
-    VD_REV_LEFT,
-    VD_REV_RIGHT,
-    VD_TURN
-} vdState;
+/*
+ * messages of the control path.  A print to UART0 can block for several ms, so
+ * the control path only sets their bits and vdReportNotices() prints them later
+ * from the logger task.
+ */
+enum {
+    VD_NOTICE_PAUSED = (1 << 0),
+    VD_NOTICE_RESUMED = (1 << 1),
+    VD_NOTICE_NOT_IN_RANGE = (1 << 2),
+    VD_NOTICE_SWITCH1 = (1 << 3),
+    VD_NOTICE_SWITCH2 = (1 << 4),
+    VD_NOTICE_SWITCH4 = (1 << 5),
+    VD_NOTICES = 6
+};
+static const char * const vdNoticeText[VD_NOTICES] = {
+    "VD Paused", "VD Resumed", "Object not in range, cannot resume.",
+    "Onboard Switch 1 Pressed", "Onboard Switch 2 Pressed", "Onboard Switch 4 Pressed"
+};
+static volatile uint32_t vdNotices = 0;
+
+static inline void vdNotice(uint32_t notice)
+{
+    __sync_fetch_and_or(&vdNotices, notice);
+}
 
-static enum {
-    VD_HAULT,
-    VD_SLOW = 35,
-    VD_MEDIUM = 50,
-    VD_FAST = 70
-} vdSpeed;
+/** Prints the messages noted since the last call, in the order of their bits */
+static void vdReportNotices(void)
+{
+    const uint32_t notices = __sync_fetch_and_and(&vdNotices, 0);
 
-static int targetDist;
-static int lastTarget;
+    for(int i = 0; i < VD_NOTICES; i++) {
+        if(notices & (1 << i)) {
+            printf("%s\n", vdNoticeText[i]);
+        }
+    }
+}
 
-/* motor drivers */
-static PWM pwmLeftFWD(PWM::pwm2, 1000); // P2.1
-static PWM pwmLeftREV(PWM::pwm3, 1000); // P2.2
-static PWM pwmRightFWD(PWM::pwm4, 1000); // P2.3
-static PWM pwmRightREV(PWM::pwm5, 1000); // P2.4
+/** Stops the dog, from any task, the next vdReadSensor() sees it */
+static void vdPause(void)
+{
+    resumeRequest = 0;
+    paused = 1;
+    vdNotice(VD_NOTICE_PAUSED);
+}
 
+/** Asks to resume from @param source (VD_RESUME_*), the sensor task checks the target is in range first */
+static void vdResumeRequest(uint8_t source)
+{
+    resumeRequest = source;
+    if(VD_POWER_STANDBY == powerMode) {
+        vdHalWakeUp();
+    }
+}
+
+/**
+ * Sleeps @param runMs, or while in standby @param standbyMs and 0 until the
+ * dog wakes up, for the vd tasks that poll
+ */
+static inline void vdIdle(uint32_t runMs, uint32_t standbyMs)
+{
+    if(VD_POWER_STANDBY != powerMode) {
+        vdHalDelayMs(runMs);
+    }
+    else {
+        vdHalStandbyWait(standbyMs);
+    }
+}
+
+static const uint32_t VD_DEBOUNCE_MS = 300;    ///< A press is acted on once, and again every this long while held
+
+/**
+ * Acts on the switches pressed, never sleeps so that it can be a slot of the
+ * executive.  The LEDs show the switches until the debounce time is over, the
+ * switches are not read again before then.
+ */
 static void vdCheckButtons(void)
 {
-    if(SW.getSwitchValues()) {
-        LE.setAll(SW.getSwitchValues());
+    static uint32_t pressedAt;
+    static bool debouncing = false;
+    const uint32_t now = vdHalTicks();
 
-        if(SW.getSwitch(1)) {
-            printf("Onboard Switch 1 Pressed\n");
-            int i;
-            /* print only 50 logs at a time, next 50 will be printed when button is pressed again */
-            for(i = 0; i < 50; i++) {
-                printf("<%4d:%4d :: %4d:%4d :: %4d:%4d>\n", rec[pi][0], rec[pi][1], rec[pi][2], rec[pi][3], rec[pi][4], rec[pi][5]);
-                pi++;
-            }
-            if(pi >= LOGLEN) pi = 0;
+    if(debouncing) {
+        if(now - pressedAt < VD_DEBOUNCE_MS) {
+            return;
         }
-        if(SW.getSwitch(2)) {
-            printf("Onboard Switch 2 Pressed\n");
-            pEnable = !pEnable;
-        }
-        if(SW.getSwitch(4)) {
-            printf("Onboard Switch 4 Pressed\n");
-            if(paused && !ZONE_IN_RANGE(sensor.middleValue)) {
-                printf("Object not in range, cannot resume.\n");
-            }
-            else {
-                paused = !paused;
-            }
+        debouncing = false;
+        vdHalLeds(0);
+    }
 
-            if(paused) {
-                printf("VD Paused\n");
-            }
-            else {
-                printf("VD Resumed\n");
-                vdState = VD_STOP;
-                vdSpeed = VD_HAULT;
-                targetDist = 1100;
-            }
+    const uint8_t switches = vdHalSwitches();
+    if(!switches) {
+        return;
+    }
+    debouncing = true;
+    pressedAt = now;
+    vdHalLeds(switches);
+
+    if(switches & (1 << 0)) {
+        /* the flight recorder is dumped by the vdlog terminal command */
+        vdNotice(VD_NOTICE_SWITCH1);
+    }
+    if(switches & (1 << 1)) {
+        vdNotice(VD_NOTICE_SWITCH2);
+        pEnable = !pEnable;
+    }
+    if(switches & (1 << 3)) {
+        vdNotice(VD_NOTICE_SWITCH4);
+        if(paused) {
+            vdResumeRequest(VD_RESUME_SWITCH);
+        }
+        else {
+            vdPause();
         }
-        delay_ms(300); // switch debouncing
-        LE.setAll(0);
     }
 }
 
-static void vdNormalizeSensorValues(void)
+/** Replaces the nominal curves by the calibration file on the SD card, if there is a valid one */
+static void vdCalibrationLoad(void)
 {
-    static int leftQueue[QLEN], middleQueue[QLEN], rightQueue[QLEN];
-    static int qTail;
-    int leftSorted[QLEN], middleSorted[QLEN], rightSorted[QLEN];
-    int i, j, leftBig, middleBig, rightBig, temp;
+#if VD_COMPACT_LAYOUT
+    /* straight over the tables in use, the task loading them is the one that converts and it is not converting yet */
+    const bool read = vdStorageReadCalibration(&calibration.buffer(), sizeof(calibration.buffer()));
+    const bool loaded = read && calibration.check();
 
+    if(!read) {
+        calibration.reset();
+    }
+#else
+    static vdCalibrationTable<VD_CHANNELS> table;   // 130 bytes per sensor, kept off the task stack
+    const bool read = vdStorageReadCalibration(&table, sizeof(table));
+    const bool loaded = read && calibration.load(table);
+#endif
 
-    /* save the current sensor value at the end of circular queue */
-    leftQueue[qTail] = adc0_get_reading(4);
-    middleQueue[qTail] = adc0_get_reading(5);
-    rightQueue[qTail] = adc0_get_reading(3);
+    if(!read) {
+        printf("No sensor calibration file, using the nominal curve\n");
+    }
+    else if(!loaded) {
+        printf("Sensor calibration file is invalid, using the nominal curve\n");
+    }
+    else {
+        printf("Sensor calibration loaded\n");
+    }
+}
 
-    /* copy queue to temporary array to perform sort */
-    //memcpy(leftSorted, leftQueue, sizeof(leftSorted));
-    //memcpy(middleSorted, middleQueue, sizeof(middleSorted));
-    //memcpy(rightSorted, rightQueue, sizeof(rightSorted));
-    /* instead of running 3 memcpy, copy in one for loop */
-    for(i = 0; i < QLEN; i++) {
-        leftSorted[i] = leftQueue[i];
-        middleSorted[i] = middleQueue[i];
-        rightSorted[i] = rightQueue[i];
+/* the loops of vdControl(), here since vdParamsApply() retunes them */
+static vdPid distancePid(VD_PID_GAIN(VD_PARAMS_DEFAULT.distanceKp), VD_PID_GAIN(VD_PARAMS_DEFAULT.distanceKi),
+                         VD_PID_GAIN(VD_PARAMS_DEFAULT.distanceKd),
+                         -VD_PARAMS_DEFAULT.speed[VD_SPEED_FAST], VD_PARAMS_DEFAULT.speed[VD_SPEED_FAST]);
+static vdPid bearingPid(VD_PID_GAIN(VD_PARAMS_DEFAULT.bearingKp), 0, VD_PID_GAIN(VD_PARAMS_DEFAULT.bearingKd),
+                        -VD_PARAMS_DEFAULT.speed[VD_SPEED_MEDIUM], VD_PARAMS_DEFAULT.speed[VD_SPEED_MEDIUM]);
+
+/** Hands the gains, speed limits and target distance in params to the controllers */
+static void vdParamsApply(void)
+{
+    targetDist = params.targetDist;
+    distancePid.setGains(VD_PID_GAIN(params.distanceKp), VD_PID_GAIN(params.distanceKi), VD_PID_GAIN(params.distanceKd),
+                         -params.speed[VD_SPEED_FAST], params.speed[VD_SPEED_FAST]);
+    bearingPid.setGains(VD_PID_GAIN(params.bearingKp), 0, VD_PID_GAIN(params.bearingKd),
+                        -params.speed[VD_SPEED_MEDIUM], params.speed[VD_SPEED_MEDIUM]);
+}
+
+/** Registers paramsSaved as disk telemetry, the scheduler restores it from the disk before taskEntry() */
+static bool vdParamsRegister(void)
+{
+    return vdStorageRegisterParams((int*) &paramsSaved, vdParamNames, VD_PARAMS_COUNT);
+}
+
+/** Hands @param p to the control path, it takes effect at the start of the next tick */
+static void vdParamsPublish(const vdParams *p)
+{
+    paramsNext.publish(*p);
+}
+
+/** Starts with the saved parameters if they are usable */
+static void vdParamsLoad(void)
+{
+    const int bad = vdParamsCheck(&paramsSaved);
+
+    if(bad >= 0) {
+        printf("Saved parameter %s is out of range, using the defaults\n", vdParamNames[bad]);
+        vdParamsPublish(&VD_PARAMS_DEFAULT);
+    }
+    else {
+        vdParamsPublish(&paramsSaved);
     }
+}
 
-    /* optimized bubble sort */
-    for(i = 0; i < QLEN; i++) {
-       for(j = leftBig = middleBig = rightBig = 0; j < (QLEN - i); j++) {
-          if(leftSorted[j] > leftSorted[leftBig]) {
-             leftBig = j;
-          }
-          if(middleSorted[j] > middleSorted[middleBig]) {
-             middleBig = j;
-          }
-          if(rightSorted[j] > rightSorted[rightBig]) {
-             rightBig = j;
-          }
-       }
+/** Takes over a newly published set, only called between two ticks */
+static inline void vdParamsSwap(void)
+{
+    static uint32_t seq;
 
-       temp = leftSorted[leftBig];
-       leftSorted[leftBig] = leftSorted[(QLEN - 1) - i];
-       leftSorted[(QLEN - 1) - i] = temp;
+    if(paramsNext.sequence() != seq) {
+        seq = paramsNext.read(params);
+        vdParamsApply();
+    }
+}
 
-       temp = middleSorted[middleBig];
-       middleSorted[middleBig] = middleSorted[(QLEN - 1) - i];
-       middleSorted[(QLEN - 1) - i] = temp;
+/**
+ * Standby and resume, once per tick in the sensor task.  Paused for
+ * VD_STANDBY_DELAY_MS, the dog goes to standby.  A resume request first brings
+ * it back to full rate and lets the filters refill with QLEN fresh samples, so
+ * the range check does not judge heartbeat readings, then resumes if the target
+ * is in range.  A request is served within one heartbeat, vdHalWakeUp() cuts it
+ * short, plus QLEN sample periods.
+ */
+static void vdPowerUpdate(void)
+{
+    static uint32_t idleSince;
+    static int refill;
+    const uint32_t now = vdHalTicks();
+    const uint8_t request = resumeRequest;
+    vdSensorReading sensor = vdSensorReading();
+
+    if(!paused) {
+        idleSince = now;
+        return;
+    }
 
-       temp = rightSorted[rightBig];
-       rightSorted[rightBig] = rightSorted[(QLEN - 1) - i];
-       rightSorted[(QLEN - 1) - i] = temp;
+    if(0 == request) {
+        if(VD_POWER_WAKING == powerMode) {
+            /* paused again before the resume was served */
+            powerMode = VD_POWER_RUN;
+            idleSince = now;
+        }
+        else if(VD_POWER_RUN == powerMode && now - idleSince >= VD_STANDBY_DELAY_MS) {
+            powerMode = VD_POWER_STANDBY;
+            vdHalStandby(true);
+        }
+        return;
     }
 
-#if 0
-    if((leftSorted[4] > (leftSorted[QLEN / 2] - THRESHOLD)) && (leftSorted[QLEN - 5] < (leftSorted[QLEN / 2] + THRESHOLD))) {
-        sensor.leftValid = 1;
-        sensor.leftValue = leftSorted[QLEN / 2];
+    if(VD_POWER_STANDBY == powerMode) {
+        powerMode = VD_POWER_WAKING;
+        refill = 0;
+        vdHalStandby(false);
+        return;
+    }
+    if(VD_POWER_WAKING == powerMode) {
+        refill += VD_BLOCK_LEN;
+        if(refill < QLEN) {
+            return;
+        }
+        powerMode = VD_POWER_RUN;
     }
 
-    if((middleSorted[4] > (middleSorted[QLEN / 2] - THRESHOLD)) && (middleSorted[QLEN - 5] < (middleSorted[QLEN / 2] + THRESHOLD))) {
-        sensor.middleValid = 1;
-        sensor.middleValue = middleSorted[QLEN / 2];
+    resumeRequest = 0;
+    idleSince = now;
+    sensorSnapshot.read(sensor);
+    if(vdZoneOf(sensor.middleValue, params.zoneBound) != VD_ZONE_IN_RANGE) {
+        vdNotice(VD_NOTICE_NOT_IN_RANGE);
+        return;
+    }
+    if(request & VD_RESUME_BT) {
+        startBT = 1;
     }
+    paused = 0;
+    vdState = VD_STOP;
+    targetDist = params.targetDist;
+    vdNotice(VD_NOTICE_RESUMED);
+}
 
-    if((rightSorted[4] > (rightSorted[QLEN / 2] - THRESHOLD)) && (rightSorted[QLEN - 5] < (rightSorted[QLEN / 2] + THRESHOLD))) {
-        sensor.rightValid = 1;
-        sensor.rightValue = rightSorted[QLEN / 2];
+/**
+ * Filter of sensor CHANNEL, see vd_filter.hpp.  Specialize it to try another
+ * strategy on one sensor, every output must rise with the counts for the
+ * conversion to mm.
+ */
+template <int CHANNEL>
+struct vdChannelFilter
+{
+    typedef vdFilter<vdRunningMedian<QLEN, vdCounts, vdWindowIndex> > type;
+};
+
+typedef vdFilterBank<vdChannelFilter, VD_CHANNELS, VD_BLOCK_LEN> vdSensorFilters;
+typedef vdTracker<VD_CHANNELS, VD_TRACK_FLOOR, VD_TRACK_COAST> vdSensorTracker;
+
+/** @returns the nearest of the distances of sensors @param first to @param last */
+static inline int vdNearest(const vdMm *mm, int first, int last)
+{
+    int nearest = mm[first];
+    for(int c = first + 1; c <= last; c++) {
+        nearest = (mm[c] < nearest) ? mm[c] : nearest;
     }
-#else
-    //sensor.leftValid = 1;
-    //sensor.middleValid = 1;
-    //sensor.rightValid = 1;
-    sensor.leftValue = leftSorted[QLEN / 2];
-    sensor.middleValue = middleSorted[QLEN / 2];
-    sensor.rightValue = rightSorted[QLEN / 2];
-#endif
+    return nearest;
+}
 
-#if ENABLE_DEBUG
-    /* maintain log of past few values for debugging */
-    /* actual values */
-    rec[ri][1] = leftQueue[qTail];
-    rec[ri][3] = middleQueue[qTail];
-    rec[ri][5] = rightQueue[qTail];
-    /* normalized values */
-    rec[ri][0] = leftSorted[QLEN / 2];
-    rec[ri][2] = middleSorted[QLEN / 2];
-    rec[ri][4] = rightSorted[QLEN / 2];
+static void vdNormalizeSensorValues(void)
+{
+    static vdSensorFilters filters;
+    static vdSensorTracker tracker;
+    vdSensorReading sensor;
+    const vdAdcBlock *block = vdAdcGetBlock();
+    int filtered[VD_CHANNELS];
+    int mm[VD_CHANNELS];
+    int divider;
+    int c, i;
+    VD_PROBE(VD_PROF_FILTER);
+
+    if(!block) {
+        return;
+    }
+    divider = (block->divider > 0) ? block->divider : 1;
 
-    if(pEnable) {
-        printf("%4d %4d %4d\n", sensor.leftValue, sensor.middleValue, sensor.rightValue);
+    /* every sensor's row of the block through its filter, once whatever the rate, see vdFilterBank */
+    filters.update(block->channel, filtered);
+
+    /* the tracker fuses the sensors sample by sample */
+    for(i = 0; i < VD_BLOCK_LEN; i++) {
+        for(c = 0; c < VD_CHANNELS; c++) {
+            mm[c] = calibration.toMm(c, block->channel[c][i]);
+        }
+        tracker.update(mm, divider);
     }
 
-    ri++;
-    if(ri >= LOGLEN) ri = 0;
-#endif
+    /* the filters run on the counts, the conversion keeps the order so only their outputs need converting */
+    for(c = 0; c < VD_CHANNELS; c++) {
+        sensor.distance[c] = calibration.toMm(c, filtered[c]);
+    }
+    sensor.leftValue = vdNearest(sensor.distance, 0, VD_MIDDLE_FIRST - 1);
+    sensor.middleValue = vdNearest(sensor.distance, VD_MIDDLE_FIRST, VD_MIDDLE_LAST);
+    sensor.rightValue = vdNearest(sensor.distance, VD_MIDDLE_LAST + 1, VD_CHANNELS - 1);
+    sensor.range = tracker.range();
+    sensor.bearing = tracker.bearing();
+    sensor.rangeRate = tracker.rangeRate(VD_SAMPLE_HZ);
+    sensor.bearingRate = tracker.bearingRate(VD_SAMPLE_HZ);
+    sensor.tracking = tracker.tracking();
+    sensor.periods = divider * VD_BLOCK_LEN;
+    sensor.timestamp = vdHalTicks();
+    sensorSnapshot.publish(sensor);
 
-    qTail++;
-    if(qTail >= QLEN) {
-        qTail = 0;
+#if ENABLE_DEBUG
+    if(pEnable) {
+        char line[10 * VD_CHANNELS + 1];
+        for(c = 0; c < VD_CHANNELS; c++) {
+            snprintf(&line[10 * c], 11, "%4d:%4d ", sensor.distance[c], block->channel[c][VD_BLOCK_LEN - 1]);
+        }
+        printf("%s\n", line);
     }
+#endif
+
+    vdHalDisplay((sensor.middleValue < 1000) ? sensor.middleValue / 10 : 99); // cm
+}
+
+/* the wheels of vdMotorOutput, wheel w is driven by PWM channels 2w (forward) and 2w + 1 (reverse) */
+enum {
+    VD_WHEEL_LEFT,
+    VD_WHEEL_RIGHT,
+    VD_WHEELS
+};
+typedef char vdWheelChannelCheck[(VD_PWM_LEFT_REV == 2 * VD_WHEEL_LEFT + 1 &&
+                                  VD_PWM_RIGHT_REV == 2 * VD_WHEEL_RIGHT + 1 && VD_PWM_CHANNELS == 2 * VD_WHEELS) ? 1 : -1];
+
+static vdMotorOutput<VD_WHEELS> motorOutput;
+static uint32_t motorWrites = 0;    ///< PWM channels written since boot
 
-    LD.setNumber(sensor.middleValue / 100); // only first two digits of sensor reading
+/** @returns the duty on the faster wheel, in percent whichever way it turns, as the recorder and telemetry report it */
+static inline int vdAppliedDuty(void)
+{
+    const int left = motorOutput.applied(VD_WHEEL_LEFT), right = motorOutput.applied(VD_WHEEL_RIGHT);
+    const int l = (left < 0) ? -left : left, r = (right < 0) ? -right : right;
+
+    return (l > r) ? l : r;
+}
+
+/**
+ * @returns true unless the dog stands still with the target still in range and
+ * the state holds, anything else needs the readings at full rate
+ */
+static inline bool vdRateBusy(const vdSensorReading& sensor, int lastState)
+{
+    if(paused) {
+        return 0 != resumeRequest;
+    }
+    return vdState != lastState || !sensor.tracking ||
+           0 != motorOutput.applied(VD_WHEEL_LEFT) || 0 != motorOutput.applied(VD_WHEEL_RIGHT) ||
+           vdZoneOf(sensor.middleValue, params.zoneBound) != VD_ZONE_IN_RANGE ||
+           sensor.rangeRate > VD_RATE_CALM_RANGE || sensor.rangeRate < -VD_RATE_CALM_RANGE ||
+           sensor.bearingRate > VD_RATE_CALM_BEARING || sensor.bearingRate < -VD_RATE_CALM_BEARING;
 }
 
 static void vdReadSensor(void)
 {
     static int alarmTarget;
+    static uint32_t lastSeq;
+    vdSensorReading sensor = vdSensorReading();
+    vdFlightRecord rec;
+    uint8_t decision;
+    int lastState;
+    VD_PROBE(VD_PROF_DECIDE);
+
+    /* first thing of a tick, vdRunMotor() of the previous one is done by now */
+    vdParamsSwap();
+    vdPowerUpdate();
 
     if(paused) {
         vdState = VD_STOP;
-        return;
     }
 
-    switch(vdState) {
-        case VD_FWD:
-            /*if((sensor.middleValue - lastTarget) > VD_THRESHOLD) {
-                /* some obstacle has been detected, sound alarm *
-                vdState = VD_ALARM;
-                alarmTarget = lastTarget;
-            }
-            else*/ if(ZONE_FAR(sensor.middleValue)) {
-                vdSpeed = VD_MEDIUM;
-            }
-            else if(ZONE_TOO_FAR(sensor.middleValue)) {
-                vdSpeed = VD_FAST;
-                if(ZONE_FAR(sensor.rightValue) || ZONE_TOO_FAR(sensor.rightValue)) {
-                    vdState = VD_FWD_RIGHT;
-                    lastTarget = sensor.rightValue;
-                }
-                else if(ZONE_FAR(sensor.leftValue) || ZONE_TOO_FAR(sensor.leftValue)) {
-                    vdState = VD_FWD_LEFT;
-                    lastTarget = sensor.leftValue;
-                }
-            }
-            else if(ZONE_OUT_OF_RANGE(sensor.middleValue)) {
-                 vdState = VD_TURN;
-            }
-            //else if(sensor.middleValue > targetDist) { /**/
-            //    vdState = VD_STOP;
-            //}
-            else if(ZONE_IN_RANGE(sensor.middleValue)) {
-                vdState = VD_STOP;
-            }
-            lastTarget = sensor.middleValue;
-            break;
+    /* nothing to decide until a new reading has been published */
+    if(sensorSnapshot.sequence() == lastSeq) {
+        return;
+    }
+    lastSeq = sensorSnapshot.read(sensor);
+    lastState = vdState;
 
-        case VD_REV:
-            /*if((sensor.middleValue - lastTarget) > VD_THRESHOLD) {
-                /* some obstacle has been detected, sound alarm *
-                vdState = VD_ALARM;
-                alarmTarget = lastTarget;
-            }
-            else*/ if(ZONE_CLOSE(sensor.middleValue)) {
-                vdSpeed = VD_SLOW;
-            }
-            else if(sensor.middleValue < targetDist) { /**/
-                vdState = VD_STOP;
-            }
-            //else if(ZONE_IN_RANGE(sensor.middleValue)) {
-            //    vdState = VD_STOP;
-            //}
-            lastTarget = sensor.middleValue;
-            break;
+    if(paused) {
+        /* only recorded */
+    }
+    /* obstacle detection (middle coming more than VD_THRESHOLD closer than lastTarget) is
+     * still disabled, so nothing enters VD_ALARM, but this is how it would leave it */
+    else if(VD_ALARM == vdState) {
+        if(alarmTarget - 40 < sensor.middleValue && alarmTarget + 40 > sensor.middleValue) {
+            vdState = VD_STOP;
+        }
+    }
+    else {
+        decision = vdDecide(vdState,
+                            vdZoneOf(sensor.leftValue, params.zoneBound), vdZoneOf(sensor.middleValue, params.zoneBound),
+                            vdZoneOf(sensor.rightValue, params.zoneBound),
+                            sensor.middleValue > targetDist);
+
+        vdState = (vdStateId) VD_DECISION_STATE(decision);
+        switch(VD_DECISION_TARGET(decision)) {
+            case VD_TARGET_LEFT:   lastTarget = sensor.leftValue;   break;
+            case VD_TARGET_MIDDLE: lastTarget = sensor.middleValue; break;
+            case VD_TARGET_RIGHT:  lastTarget = sensor.rightValue;  break;
+            default: break;
+        }
+    }
 
-        case VD_TURN:
-            if(ZONE_FAR(sensor.rightValue) || ZONE_TOO_FAR(sensor.rightValue)) {
-                vdState = VD_FWD_RIGHT;
-                lastTarget = sensor.rightValue;
-            }
-            else if(ZONE_FAR(sensor.leftValue) || ZONE_TOO_FAR(sensor.leftValue)) {
-                vdState = VD_FWD_LEFT;
-                lastTarget = sensor.leftValue;
-            }
-            else if(ZONE_IN_RANGE(sensor.rightValue) || ZONE_CLOSE(sensor.rightValue)) {
-                vdState = VD_REV_LEFT;
-                lastTarget = sensor.rightValue;
-            }
-            else if(ZONE_IN_RANGE(sensor.leftValue) || ZONE_CLOSE(sensor.leftValue)) {
-                vdState = VD_REV_RIGHT;
-                lastTarget = sensor.leftValue;
-            }
-            break;
+    /* every reading and what was decided on it goes to the flight recorder */
+    rec.timestamp = sensor.timestamp;
+    rec.left = sensor.leftValue;
+    rec.middle = sensor.middleValue;
+    rec.right = sensor.rightValue;
+    rec.state = vdState;
+    rec.speed = vdAppliedDuty();
+    rec.flags = paused ? VD_REC_PAUSED : 0;
+    flightRecorder.write(rec);
+
+    /* the next readings come sooner or later depending on how much is going on */
+    vdHalSampleDivider(rateGovernor.update(vdRateBusy(sensor, lastState), sensor.periods));
+}
 
-        case VD_FWD_LEFT:
-            if(ZONE_FAR(sensor.middleValue) || ZONE_IN_RANGE(sensor.middleValue) || ZONE_CLOSE(sensor.middleValue)) {
-                vdState = VD_STOP;
-            }
-            lastTarget = sensor.middleValue;
-            break;
+/** Sets the duties the wheels ramp to, vdMotorUpdate() writes them */
+static inline void vdMotorDrive(int leftFWD, int leftREV, int rightFWD, int rightREV)
+{
+    motorOutput.set(VD_WHEEL_LEFT, (leftFWD) ? (leftFWD + params.leftError) : (leftREV) ? -(leftREV + params.leftError) : 0);
+    motorOutput.set(VD_WHEEL_RIGHT, (rightFWD) ? (rightFWD + params.rightError) : (rightREV) ? -(rightREV + params.rightError) : 0);
+}
 
-        case VD_FWD_RIGHT:
-            if(ZONE_FAR(sensor.middleValue) || ZONE_IN_RANGE(sensor.middleValue) || ZONE_CLOSE(sensor.middleValue)) {
-                vdState = VD_STOP;
-            }
-            lastTarget = sensor.middleValue;
-            break;
+/**
+ * One step of the motor ramps, writes only the PWM channels whose duty changed,
+ * see vd_motor.hpp.  The ramps move by the time since the last step, so a
+ * wakeup without a new reading moves them only as far as it lasted, but by no
+ * more than the @param periods of the latest reading: time spent waiting does
+ * not add up to a jump once a new duty is set.
+ */
+static void vdMotorUpdate(int periods)
+{
+    static uint32_t lastMs;
+    static int slewCarry;       ///< Slew of the time stepped so far not yet applied, in 1/1000 % duty
+    const uint32_t now = vdHalTicks();
+    const uint32_t maxMs = (uint32_t) periods * 1000 / VD_SAMPLE_HZ;
+    const uint32_t ms = (now - lastMs < maxMs) ? now - lastMs : maxMs;
+    int c;
+
+    lastMs = now;
+    slewCarry += params.motorSlew * (int) ms;
+    const int step = slewCarry / 1000;
+    slewCarry -= step * 1000;
+
+    const uint32_t changed = motorOutput.update(step);
+
+    for(c = 0; c < VD_PWM_CHANNELS; c++) {
+        if(changed & (1u << c)) {
+            vdHalPwmSet(c, motorOutput.duty(c));
+            motorWrites++;
+        }
+    }
+}
 
-        case VD_REV_LEFT:
-            if(ZONE_IN_RANGE(sensor.middleValue) || ZONE_CLOSE(sensor.middleValue)) {
-                vdState = VD_STOP;
-            }
-            lastTarget = sensor.middleValue;
-            break;
+/* closed loop on the middle reading (distance) and on right - left (bearing), see vd_pid.hpp */
+static const int VD_DUTY_MIN = 5;   ///< Less than this does not turn a wheel, so it is not driven at all
 
-        case VD_REV_RIGHT:
-            if(ZONE_IN_RANGE(sensor.middleValue) || ZONE_CLOSE(sensor.middleValue)) {
-                vdState = VD_STOP;
-            }
-            lastTarget = sensor.middleValue;
-            break;
+/**
+ * Drives each wheel with a signed duty, negative is reverse.  Both are clamped to
+ * the same limit, under which the larger trim still fits in 100 %: a limit per
+ * wheel would let the one with the smaller trim run faster at saturation, and
+ * the trims are there to make both wheels equally fast.
+ */
+static void vdMotorDriveSigned(int left, int right)
+{
+    const int dutyMax = 100 - ((params.leftError > params.rightError) ? params.leftError : params.rightError);
 
-        case VD_ALARM:
-            if(alarmTarget - 200 < sensor.middleValue && alarmTarget + 200 > sensor.middleValue) {
-                vdState = VD_STOP;
-            }
-            break;
+    left = (left > dutyMax) ? dutyMax : (left < -dutyMax) ? -dutyMax : left;
+    right = (right > dutyMax) ? dutyMax : (right < -dutyMax) ? -dutyMax : right;
 
-        case VD_STOP:
-        default:
-            /*if((sensor.middleValue - lastTarget) > VD_THRESHOLD) {
-                /* some obstacle has been detected, sound alarm *
-                vdState = VD_ALARM;
-                alarmTarget = lastTarget;
-            }
-            else*/ if(ZONE_FAR(sensor.middleValue) || ZONE_TOO_FAR(sensor.middleValue) || ZONE_OUT_OF_RANGE(sensor.middleValue)) {
-                vdState = VD_FWD;
-            }
-            else if(ZONE_CLOSE(sensor.middleValue)) {
-                vdState = VD_REV;
-            }
-            lastTarget = sensor.middleValue;
-            break;
-    }
+    vdMotorDrive((left >= VD_DUTY_MIN) ? left : VD_HAULT, (left <= -VD_DUTY_MIN) ? -left : VD_HAULT,
+                 (right >= VD_DUTY_MIN) ? right : VD_HAULT, (right <= -VD_DUTY_MIN) ? -right : VD_HAULT);
 }
 
-static inline void vdMotorDrive(int leftFWD, int leftREV, int rightFWD, int rightREV)
+/* states in which the middle sensor has the target and the controller steers */
+static inline bool vdClosedLoop(int state)
 {
-    pwmLeftFWD.set((leftFWD)? (leftFWD + VD_LEFT_ERROR/* + VD_LEFT_ERROR / 2*/): VD_HAULT);
-    pwmLeftREV.set((leftREV)? (leftREV + VD_LEFT_ERROR/* + VD_LEFT_ERROR*/): VD_HAULT);
-    pwmRightFWD.set((rightFWD)? (rightFWD + VD_RIGHT_ERROR): VD_HAULT);
-    pwmRightREV.set((rightREV)? (rightREV + VD_RIGHT_ERROR): VD_HAULT);
+    return VD_STOP == state || VD_FWD == state || VD_REV == state || VD_FWD_LEFT == state || VD_FWD_RIGHT == state;
 }
 
-static void vdRunMotor(void)
+/**
+ * One controller step on the distances in mm, a target beyond targetDist is a
+ * negative error so the distance output is negated to drive forward.  While the
+ * tracker has the target its rate damps the distance loop: it leads the median
+ * by the ~150 ms the median window lags, and is not quantized by it.  It goes
+ * in as 1/256 mm per period, a target closing at a few mm/s is damped too.
+ */
+static void vdControl(const vdSensorReading& sensor)
 {
-    static int lastState = VD_STOP;
-
-     if(paused) {
-        vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, VD_HAULT);
-        return;
-     }
+    VD_PROBE(VD_PROF_CONTROL);
 
-     if(vdState == lastState) {
-          return;
-     }
+    distancePid.setPeriods(sensor.periods / VD_BLOCK_LEN);
+    bearingPid.setPeriods(sensor.periods / VD_BLOCK_LEN);
+    const int forward = -(sensor.tracking ?
+            distancePid.update(targetDist, sensor.middleValue, sensor.rangeRate * 256 * VD_BLOCK_LEN / VD_SAMPLE_HZ) :
+            distancePid.update(targetDist, sensor.middleValue));
+    const int turn = bearingPid.update(0, sensor.rightValue - sensor.leftValue); // > 0 turns right
 
-    switch(vdState) {
-        case VD_FWD:
-            vdMotorDrive(vdSpeed, VD_HAULT, vdSpeed, VD_HAULT);
-            break;
+    vdMotorDriveSigned(forward + turn, forward - turn);
+}
 
-        case VD_REV:
-            vdMotorDrive(VD_HAULT, vdSpeed, VD_HAULT, vdSpeed);
-            break;
+static void vdRunMotor(void)
+{
+    static int lastState = VD_STOP;
+    static uint32_t lastSeq;
+    vdSensorReading sensor = vdSensorReading();
+    VD_PROBE(VD_PROF_MOTOR);
 
-        case VD_FWD_LEFT:
-            vdMotorDrive(VD_SLOW, VD_HAULT, VD_FAST + VD_SLOW, VD_HAULT);
-            break;
+    /* the controller steps over the sample periods of the latest reading, the ramps over the time since their last step */
+    const uint32_t seq = sensorSnapshot.read(sensor);
+    const int periods = (0 != seq) ? sensor.periods : VD_BLOCK_LEN;
 
-        case VD_FWD_RIGHT:
-            vdMotorDrive(VD_FAST, VD_HAULT, VD_SLOW, VD_HAULT);
-            break;
+    /* the duties are set again on every tick, vdMotorUpdate() only writes the ones that changed */
+    if(paused) {
+        vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, VD_HAULT);
+        lastState = VD_NUM_STATES; // the loops restart from scratch on resume
+    }
+    else if(vdClosedLoop(vdState)) {
+        if(!vdClosedLoop(lastState)) {
+            distancePid.reset();
+            bearingPid.reset();
+        }
+        lastState = vdState;
 
-        case VD_REV_LEFT:
-            vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, VD_MEDIUM);
-            break;
+        /* one controller step per reading */
+        if(0 != seq && seq != lastSeq) {
+            lastSeq = seq;
+            vdControl(sensor);
+        }
+    }
+    else {
+        /* searching for the target, open loop */
+        switch(vdState) {
+            case VD_REV_LEFT:
+                vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, params.speed[VD_SPEED_MEDIUM]);
+                break;
 
-        case VD_REV_RIGHT:
-            vdMotorDrive(VD_HAULT, VD_MEDIUM, VD_HAULT, VD_HAULT);
-            break;
+            case VD_REV_RIGHT:
+                vdMotorDrive(VD_HAULT, params.speed[VD_SPEED_MEDIUM], VD_HAULT, VD_HAULT);
+                break;
 
-        default:
-            vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, VD_HAULT);
-            break;
+            default:
+                vdMotorDrive(VD_HAULT, VD_HAULT, VD_HAULT, VD_HAULT);
+                break;
+        }
+        lastState = vdState;
     }
 
-    lastState = vdState;
+    vdMotorUpdate(periods);
 }
 
+/* LED/buzzer patterns, one per vdState, played by vdIndicatorTask without blocking anyone */
+typedef struct {
+        uint8_t leds;       ///< LE mask, bit 0 is LED 1
+        uint8_t buzzer;     ///< 1 turns on the P1.23 buzzer
+        uint16_t ms;        ///< How long to hold this step, 0 holds it until the state changes
+} vdPatternStep;
+
+typedef struct {
+        const vdPatternStep *steps;
+        int count;
+} vdPattern;
+
+#define VD_PATTERN(steps)       { steps, sizeof(steps) / sizeof(steps[0]) }
+
+static const vdPatternStep patternOff[]       = { {0x0, 0, 0} };
+static const vdPatternStep patternAlarm[]     = { {0xF, 1, 100}, {0x0, 1, 400}, {0x0, 0, 500} };
+static const vdPatternStep patternStop[]      = { {0x6, 0, 500}, {0x9, 0, 500} };
+static const vdPatternStep patternFwd[]       = { {0x6, 0, 0} };
+static const vdPatternStep patternRev[]       = { {0x9, 0, 0} };
+static const vdPatternStep patternFwdLeft[]   = { {0x3, 0, 0} };
+static const vdPatternStep patternFwdRight[]  = { {0xC, 0, 0} };
+static const vdPatternStep patternRevLeft[]   = { {0x1, 0, 0} };
+static const vdPatternStep patternRevRight[]  = { {0x8, 0, 0} };
+static const vdPatternStep patternTurn[]      = { {0x9, 0, 100}, {0x0, 0, 500} };
+
+/* indexed by vdState */
+static const vdPattern vdPatterns[] = {
+    VD_PATTERN(patternAlarm),       // VD_ALARM
+    VD_PATTERN(patternStop),        // VD_STOP
+    VD_PATTERN(patternFwd),         // VD_FWD
+    VD_PATTERN(patternRev),         // VD_REV
+    VD_PATTERN(patternFwdLeft),     // VD_FWD_LEFT
+    VD_PATTERN(patternFwdRight),    // VD_FWD_RIGHT
+    VD_PATTERN(patternRevLeft),     // VD_REV_LEFT
+    VD_PATTERN(patternRevRight),    // VD_REV_RIGHT
+    VD_PATTERN(patternTurn),        // VD_TURN
+};
+static const vdPattern vdPatternPaused = VD_PATTERN(patternOff);
+
+/**
+ * Advances the indicator pattern of the current state, never sleeps.
+ * LEDs and buzzer are only written when the step changes.
+ */
 static void vdIndicatorLED(void)
 {
-    if(paused) {
-        LE.setAll(0);
-        return;
+    static const vdPattern *pattern = 0;
+    static int step;
+    static uint32_t stepStart;
+    const uint32_t now = vdHalTicks();
+    const vdPattern *want = paused ? &vdPatternPaused : &vdPatterns[vdState];
+    const vdPatternStep *s;
+
+    if(want != pattern) {
+        pattern = want;
+        step = 0;
+    }
+    else {
+        s = &pattern->steps[step];
+        if(0 == s->ms || (now - stepStart) < s->ms) {
+            return;
+        }
+        if(++step >= pattern->count) {
+            step = 0;
+        }
     }
 
-    switch(vdState) {
-        case VD_FWD:
-            LE.off(1);
-            LE.on(2);
-            LE.on(3);
-            LE.off(4);
-            break;
-
-        case VD_REV:
-            LE.on(1);
-            LE.off(2);
-            LE.off(3);
-            LE.on(4);
-            break;
-
-        case VD_TURN:
-            LE.on(1);
-            LE.off(2);
-            LE.off(3);
-            LE.on(4);
-            delay_ms(100);
-            LE.off(1);
-            LE.off(2);
-            LE.off(3);
-            LE.off(4);
-            delay_ms(500);
-            break;
-
-        case VD_FWD_LEFT:
-            LE.on(1);
-            LE.on(2);
-            LE.off(3);
-            LE.off(4);
-            break;
+    s = &pattern->steps[step];
+    stepStart = now;
+    vdHalLeds(s->leds);
+    vdHalBuzzer(s->buzzer);
+}
 
-        case VD_FWD_RIGHT:
-            LE.off(1);
-            LE.off(2);
-            LE.on(3);
-            LE.on(4);
-            break;
+static void vdBluetoothRx(void)
+{
+    vdBtCommand cmd;
 
-        case VD_REV_LEFT:
-            LE.on(1);
-            LE.off(2);
-            LE.off(3);
-            LE.off(4);
-            break;
+    /* vdBluetoothRxTask sleeps until the UART2 ISR has received a complete, valid frame, a slot only polls */
+    if(!vdBluetoothGetCommand(cmd, !VD_CYCLIC_EXECUTIVE)) {
+        return;
+    }
 
-        case VD_REV_RIGHT:
-            LE.off(1);
-            LE.off(2);
-            LE.off(3);
-            LE.on(4);
+    //printf("BT command received %d\n", cmd.payload[0]);
+    switch(cmd.payload[0]) {
+        case VD_BT_CMD_START:
+            if(paused) {
+                vdResumeRequest(VD_RESUME_BT);
+            }
+            //printf("BT started\n");
             break;
 
-        case VD_ALARM:
-            LE.on(1);
-            LE.on(2);
-            LE.on(3);
-            LE.on(4);
-            delay_ms(100);
-            LE.off(1);
-            LE.off(2);
-            LE.off(3);
-            LE.off(4);
-            delay_ms(100);
+        case VD_BT_CMD_STOP:
+            startBT = 0;
+            vdPause();
+            //printf("BT stopped\n");
             break;
 
-        case VD_STOP:
         default:
-            LE.off(1);
-            LE.on(2);
-            LE.on(3);
-            LE.off(4);
-            delay_ms(500);
-            LE.on(1);
-            LE.off(2);
-            LE.off(3);
-            LE.on(4);
-            delay_ms(500);
+            /* unknown commands are ignored instead of pausing the dog */
             break;
     }
 }
 
-static void vdBuzzer(void)
+static void vdBluetoothTx(void)
 {
-    const uint32_t buzzerBit = (1 << 23);
+    static uint32_t lastSeq;
+    vdSensorReading sensor;
+    uint8_t frame[VD_TLM_FRAME_LEN];
+    uint32_t seq;
+    VD_PROBE(VD_PROF_TELEMETRY);
 
-    if(paused) {
-        LPC_GPIO1->FIOCLR = buzzerBit;
+    if(!startBT) {
         return;
     }
 
-    if(vdState == VD_ALARM) {
-        LPC_GPIO1->FIOSET = buzzerBit;
-        delay_ms(500);
-        LPC_GPIO1->FIOCLR = buzzerBit;
-        delay_ms(500);
+    /* one frame per new sensor reading */
+    seq = sensorSnapshot.read(sensor);
+    if(0 == seq || seq == lastSeq) {
+        return;
     }
+    lastSeq = seq;
+
+    vdBluetoothSend(frame, vdTelemetryEncode(frame, seq, sensor.timestamp,
+                                             sensor.leftValue, sensor.middleValue, sensor.rightValue,
+                                             vdState, vdAppliedDuty()));
 }
 
-static void txbyte(char byte){
-    printf("sending %c[%d]\n", byte, byte);
-    LPC_UART2->THR = byte;
-    while(! (LPC_UART2->LSR & (1 << 6)));
+/** Starts the next log file if there is none or the last one is full, @returns false if it could not */
+static bool vdLogOpen(void)
+{
+    if(0 == logGeneration) {
+        logChunkIndex = 0;
+        if(!vdStorageOpen(logGeneration)) {
+            logGeneration = 0;
+        }
+    }
+    return 0 != logGeneration;
 }
 
-static void vdBluetoothRx(void)
+/** Writes @param len bytes at @param offset into the chunk being stored, a failure drops the chunk */
+static bool vdLogWrite(uint32_t offset, const void *data, int len, bool sync)
 {
-    int rv;
+    const uint32_t start = vdHalTicks();
 
-    while(! (LPC_UART2->LSR & (1<<0)));
-    rv = LPC_UART2->RBR;
+    if(!vdStorageWrite(logChunkIndex * VD_LOG_CHUNK_BYTES + offset, data, len, sync)) {
+        logLost += logFill - 1;
+        logGeneration = 0;
+        logFill = 1;
+        return false;
+    }
 
-    //printf("BT data received %d\n", rv);
-    if(rv == 3) {
-        if(!ZONE_IN_RANGE(sensor.middleValue)) {
-            printf("Object not in range, cannot resume.\n");
-        }
-        else {
-            startBT = 1;
-            paused = 0;
+    const uint32_t ms = vdHalTicks() - start;
+    if(ms > logMaxWriteMs) {
+        logMaxWriteMs = ms;
+    }
+    return true;
+}
+
+/** Ends the chunk with its header, written and flushed last so a chunk cut short never decodes */
+static void vdLogChunkDone(void *chunk)
+{
+    vdLogHeader header;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, VD_LOG_MAGIC, sizeof(header.magic));
+    header.generation = logGeneration;
+    header.chunk = logChunkIndex;
+    header.lost = logLost;
+    header.blockWords = VD_REC_BLOCK_WORDS;
+    header.periodMs = 1000 / VD_SAMPLE_HZ;
+
+    if(chunk) {
+        memcpy(chunk, &header, sizeof(header));
+        if(!vdLogWrite(0, chunk, VD_LOG_CHUNK_BYTES, true)) {
+            return;
         }
-        //printf("BT started\n");
     }
-    else {
-        startBT = 0;
-        paused = 1;
-        //printf("BT stopped\n");
+    else if(!vdLogWrite(0, &header, sizeof(header), true)) {
+        return;
+    }
+
+    logWrites++;
+    if(++logChunkIndex >= VD_LOG_FILE_BYTES / VD_LOG_CHUNK_BYTES) {
+        logGeneration = 0;
     }
+    logFill = 1;
 }
 
-static void vdBluetoothTx(void)
+/**
+ * Moves finished flight recorder blocks to storage, one chunk at a time.  The
+ * recorder ring holds several seconds of blocks, so a slow write only delays this
+ * function and never the sensor task that fills the recorder.
+ *
+ * The compact layout has no room for a whole chunk and writes each block into
+ * place as it is copied, then the header.  The file reads the same, it just
+ * takes VD_LOG_CHUNK_BLOCKS writes and one flush per chunk instead of one.
+ */
+static void vdLogger(void)
 {
-    int i;
+    for(;;) {
+#if VD_COMPACT_LAYOUT
+        uint16_t *block = logBlock;
+#else
+        uint16_t *block = logChunk[logFill];
+#endif
+        const int result = flightRecorder.copyBlock(logSeq, block);
+        if(VD_REC_BLOCK_PENDING == result) {
+            return;
+        }
+        if(VD_REC_BLOCK_LOST == result) {
+            const uint32_t oldest = flightRecorder.oldest();
+            logLost += oldest - logSeq;
+            logSeq = oldest;
+            continue;
+        }
+        logSeq++;
 
-    if(!startBT) {
-        return;
-    }
-    //    sensor.leftValue = 3000;
-    //    sensor.rightValue = 4000;
-    //    sensor.middleValue = 5000;
-    int left,middle,right;
-    while(1){
-        if(!startBT) {
-            break;
+#if VD_COMPACT_LAYOUT
+        /* without a file, a chunk's worth of blocks is dropped before the next try */
+        if(0 == logGeneration && (1 != logFill || !vdLogOpen())) {
+            logLost++;
+            if(++logFill >= VD_LOG_CHUNK_BLOCKS) {
+                logFill = 1;
+            }
+            continue;
+        }
+        if(!vdLogWrite(logFill * sizeof(logBlock), block, sizeof(logBlock), false)) {
+            logLost++;
+            continue;
         }
-        txbyte('0');        // dummy byte
-        left  = sensor.leftValue;
-        middle = sensor.middleValue;
-        right = sensor.rightValue;
-
-        while(left) {
-            txbyte((left % 10) + '0');
-            left = left / 10;
+        if(++logFill >= VD_LOG_CHUNK_BLOCKS) {
+            vdLogChunkDone(NULL);
+            return;
         }
-        txbyte('~');
-        while(middle) {
-            txbyte((middle % 10) + '0');
-            middle = middle / 10;
+#else
+        if(++logFill < VD_LOG_CHUNK_BLOCKS) {
+            continue;
         }
-        txbyte('~');
-        while(right) {
-            txbyte((right % 10) + '0');
-            right = right / 10;
+        if(!vdLogOpen()) {
+            logLost += VD_LOG_CHUNK_BLOCKS - 1;
+            logFill = 1;
+            return;
         }
-        txbyte('~');
+        vdLogChunkDone(logChunk);
+        return;
+#endif
+    }
+}
 
-        txbyte(vdState+'0');
-        txbyte('\n');
-        delay_ms(300);
+/* the vd stages as the slots of vdExecutiveTask, the host simulation runs the same frames */
+static bool frameFresh;     ///< The frame was started by a new block of samples
 
+static void vdFilterSlot(void)
+{
+    if(frameFresh) {
+        vdNormalizeSensorValues();
     }
 }
 
+/* budgets at 48 MHz, a frame is 10 ms at the full sample rate */
+static const vdSlot vdSlots[] = {
+    /* name         run                     period ms               budget us */
+    { "bt rx",      vdBluetoothRx,          0,                      50 },
+    { "filter",     vdFilterSlot,           0,                      400 },
+    { "decide",     vdReadSensor,           0,                      150 },
+    { "motor",      vdRunMotor,             0,                      250 },
+    { "indicator",  vdIndicatorLED,         0,                      50 },
+    { "bt tx",      vdBluetoothTx,          0,                      150 },
+    { "buttons",    vdCheckButtons,         VD_STANDBY_BUTTON_MS,   100 },
+};
+static const int VD_SLOTS = sizeof(vdSlots) / sizeof(vdSlots[0]);
+static vdExecutive<VD_SLOTS> executive(vdSlots, 1000000 / VD_SAMPLE_HZ * VD_BLOCK_LEN);
+
+static void vdExecutiveInit(void)
+{
+    vdHalCycleCounterInit();
+}
+
+/** Runs one frame of slots, @param fresh if a new block of samples started it */
+static void vdExecutiveFrame(bool fresh)
+{
+    frameFresh = fresh;
+    executive.frame();
+}
+
+/* static RAM of the vd modules, the constant tables stay in flash.  The backend lists its own, see vdHalRam() */
+static const vdRamUse vdRamModules[] = {
+    { "filters",    sizeof(vdSensorFilters) },
+    { "tracker",    sizeof(vdSensorTracker) },
+    { "calibration", sizeof(calibration) + (VD_COMPACT_LAYOUT ? 0 : sizeof(vdCalibrationTable<VD_CHANNELS>)) },
+    { "snapshot",   sizeof(sensorSnapshot) },
+    { "params",     sizeof(params) + sizeof(paramsNext) + sizeof(paramsSaved) },
+    { "control",    sizeof(distancePid) + sizeof(bearingPid) + sizeof(rateGovernor) },
+    { "motor",      sizeof(motorOutput) },
+    { "recorder",   sizeof(flightRecorder) },
+#if VD_COMPACT_LAYOUT
+    { "log block",  sizeof(logBlock) },
+#else
+    { "log chunk",  sizeof(logChunk) },
+#endif
+#if VD_ENABLE_PROFILING
+    { "profile",    sizeof(vdProfile) },
+#endif
+    { "executive",  sizeof(executive) },
+};
+static const int VD_RAM_MODULES = sizeof(vdRamModules) / sizeof(vdRamModules[0]);
+
+/* the printf macro above is only meant for the vd debug messages */
+#undef printf
+
+#if !VD_HOST_SIM
+#include "vd_terminal.hpp"
+#endif
+
 #if 0
 #define pLINE() if(sEnable) printf("{%4d} ", __LINE__)
 
@@ -0,0 +1,120 @@
+/**
+ * @file
+ * @brief Cyclic executive running the vd stages as fixed-order slots of one task.
+ *
+ * With VD_CYCLIC_EXECUTIVE set, vdExecutiveTask replaces the task-per-stage
+ * pipeline.  Its frame is paced by the ADC ISR: every block of samples starts
+ * one, and the slots of the table run to completion in table order, so the
+ * order of filter, decision, actuation, indication and telemetry is fixed and
+ * no context switch or notification sits between two stages.
+ *
+ * A slot with a period only runs in the first frame after that many ms have
+ * passed since it last ran, the others run in every frame.  Each run is timed
+ * against the slot's declared budget, and one that takes longer counts an
+ * overrun.  A frame whose slots take longer than the shortest frame period,
+ * one block at the full sample rate, counts a frame overrun: the next block is
+ * then late or lost (adcOverruns).
+ *
+ * A stats reset is requested by another task and applied by the next frame,
+ * like the vd_profile.hpp counters.
+ */
+#ifndef VD_EXECUTIVE_HPP_
+#define VD_EXECUTIVE_HPP_
+
+#include <stdint.h>
+
+typedef struct {
+        const char *name;
+        void (*run)(void);
+        uint16_t periodMs;      ///< Runs at most once per period, 0 in every frame
+        uint16_t budgetUs;      ///< Declared worst case
+} vdSlot;
+
+typedef struct {
+        uint32_t runs;
+        uint32_t overruns;      ///< Runs longer than the budget
+        uint32_t maxCycles;
+        uint32_t lastRun;       ///< vdHalTicks() of the last run
+} vdSlotStats;
+
+template <int SLOTS>
+class vdExecutive
+{
+    public:
+        /** @param slots is a table of SLOTS slots, @param frameUs the shortest frame period */
+        vdExecutive(const vdSlot *slots, uint32_t frameUs) :
+            mSlots(slots), mFrameUs(frameUs), mResetPending(true)
+        {
+        }
+
+        /** Runs every slot that is due, in table order */
+        void frame(void)
+        {
+            const uint32_t now = vdHalTicks();
+            const uint32_t perUs = vdHalCyclesPerUs();
+            const uint32_t start = vdHalCycles();
+            int i;
+
+            if(mResetPending) {
+                clear();
+            }
+
+            for(i = 0; i < SLOTS; i++) {
+                const vdSlot *slot = &mSlots[i];
+                vdSlotStats *s = &mStats[i];
+
+                if(slot->periodMs && s->runs && (now - s->lastRun) < slot->periodMs) {
+                    continue;
+                }
+
+                const uint32_t begin = vdHalCycles();
+                slot->run();
+                const uint32_t cycles = vdHalCycles() - begin;
+
+                s->runs++;
+                s->lastRun = now;
+                s->maxCycles = (cycles > s->maxCycles) ? cycles : s->maxCycles;
+                s->overruns += (cycles > slot->budgetUs * perUs);
+            }
+
+            const uint32_t cycles = vdHalCycles() - start;
+            mFrames++;
+            mMaxFrameCycles = (cycles > mMaxFrameCycles) ? cycles : mMaxFrameCycles;
+            mFrameOverruns += (cycles > mFrameUs * perUs);
+        }
+
+        /** Asks the next frame to start the stats over */
+        inline void reset(void) { mResetPending = true; }
+
+        inline const vdSlot& slot(int i) const { return mSlots[i]; }
+        inline const vdSlotStats& stats(int i) const { return mStats[i]; }
+        inline uint32_t frames(void) const { return mFrames; }
+        inline uint32_t frameOverruns(void) const { return mFrameOverruns; }
+        inline uint32_t maxFrameCycles(void) const { return mMaxFrameCycles; }
+        inline uint32_t frameUs(void) const { return mFrameUs; }
+
+    private:
+        void clear(void)
+        {
+            for(int i = 0; i < SLOTS; i++) {
+                mStats[i].runs = 0;
+                mStats[i].overruns = 0;
+                mStats[i].maxCycles = 0;
+                mStats[i].lastRun = 0;
+            }
+            mFrames = 0;
+            mFrameOverruns = 0;
+            mMaxFrameCycles = 0;
+            mResetPending = false;
+        }
+
+        const vdSlot *mSlots;
+        const uint32_t mFrameUs;
+        vdSlotStats mStats[SLOTS];
+        uint32_t mFrames;
+        uint32_t mFrameOverruns;
+        uint32_t mMaxFrameCycles;
+        volatile bool mResetPending;
+};
+
+#endif /* VD_EXECUTIVE_HPP_ */
@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Sensor channel filters composed at compile time.
+ *
+ * A filter is a chain of up to four stages, each a class with
+ * `int update(int sample)` returning its output, which is fed to the next one :
+ * @code
+ *     vdFilter<vdOutlierReject<400>, vdRunningMedian<9>, vdEma<64> > filter;
+ *     int out = filter.update(sample);
+ * @endcode
+ *
+ * The stages and their parameters are template arguments, so the chain is one
+ * inlined expression: no virtual call, no function pointer and no branch on a
+ * configuration value on the sample path.  Unused stages are vdPass, which the
+ * compiler removes entirely.  vdRunningMedian (vd_median.hpp) is a stage as is.
+ *
+ * vdFilterBank holds one filter per sensor channel, each of its own type.
+ */
+#ifndef VD_FILTER_HPP_
+#define VD_FILTER_HPP_
+
+#include <stdint.h>
+#include "vd_median.hpp"
+
+/** Does nothing, fills the unused stages of a vdFilter */
+class vdPass
+{
+    public:
+        inline int update(int sample) { return sample; }
+};
+
+/**
+ * Exponential moving average with ALPHA in 1/256, Q8 state.  Starts at 0 like
+ * the median window, the time constant is about 256 / ALPHA samples.
+ */
+template <int ALPHA>
+class vdEma
+{
+    public:
+        vdEma() : mY(0) { }
+
+        inline int update(int sample)
+        {
+            mY += (ALPHA * ((sample << 8) - mY)) >> 8;
+            return mY >> 8;
+        }
+
+    private:
+        int32_t mY;     ///< Q8
+};
+
+/**
+ * Holds the last accepted sample instead of one that differs from it by more
+ * than LIMIT, unless RUN of them in a row show that the signal really moved.
+ */
+template <int LIMIT, int RUN = 3>
+class vdOutlierReject
+{
+    public:
+        vdOutlierReject() : mLast(0), mRun(0) { }
+
+        inline int update(int sample)
+        {
+            const int d = sample - mLast;
+
+            if((d > LIMIT || d < -LIMIT) && ++mRun < RUN) {
+                return mLast;
+            }
+            mRun = 0;
+            mLast = sample;
+            return sample;
+        }
+
+    private:
+        int mLast;
+        int mRun;
+};
+
+/** Chains the stages in order, S1 sees the raw samples */
+template <class S1, class S2 = vdPass, class S3 = vdPass, class S4 = vdPass>
+class vdFilter
+{
+    public:
+        inline int update(int sample)
+        {
+            return mS4.update(mS3.update(mS2.update(mS1.update(sample))));
+        }
+
+    private:
+        S1 mS1;
+        S2 mS2;
+        S3 mS3;
+        S4 mS4;
+};
+
+/**
+ * The filters of CHANNELS channels, FILTER<c>::type being the one of channel c.
+ * A block is channel-major, LEN samples of channel 0 then of channel 1 and so
+ * on, and each filter runs over its own contiguous row.  The recursion over the
+ * channels is resolved by the compiler, so the cost is one inlined filter loop
+ * per channel and grows linearly with their number.
+ *
+ * Every scan is filtered once whatever the sample rate, so the filter work per
+ * second drops with the rate.  At a reduced rate a window of N samples spans
+ * more time, which only happens while the target stands still: a median
+ * follows a step after N/2 new samples at any rate, and the rate is back to
+ * full as soon as the target moves (see vd_rate.hpp).
+ */
+template <template <int> class FILTER, int CHANNELS, int LEN>
+class vdFilterBank : public vdFilterBank<FILTER, CHANNELS - 1, LEN>
+{
+    public:
+        /** Filters every row of @param block and stores the last output of channel c in @param out[c] */
+        inline void update(const uint16_t (*block)[LEN], int *out)
+        {
+            const uint16_t *row = block[CHANNELS - 1];
+            int y = 0;
+
+            vdFilterBank<FILTER, CHANNELS - 1, LEN>::update(block, out);
+            for(int i = 0; i < LEN; i++) {
+                y = mFilter.update(row[i]);
+            }
+            out[CHANNELS - 1] = y;
+        }
+
+    private:
+        typename FILTER<CHANNELS - 1>::type mFilter;
+};
+
+template <template <int> class FILTER, int LEN>
+class vdFilterBank<FILTER, 0, LEN>
+{
+    public:
+        inline void update(const uint16_t (*block)[LEN], int *out) { }
+};
+
+#endif /* VD_FILTER_HPP_ */
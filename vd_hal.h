@@ -0,0 +1,101 @@
+/**
+ * @file
+ * @brief Hardware abstraction used by the vd control code in vd_essentials.cpp.
+ *
+ * The filter, state machine, motor mapping and telemetry encoder only talk to
+ * the hardware through the functions declared here.  The SJOne board backend is
+ * vd_hal_lpc.hpp; building with VD_HOST_SIM set to 1 selects the Linux backend
+ * in host/vd_hal_host.hpp instead, which runs the same code on a virtual clock.
+ */
+#ifndef VD_HAL_H__
+#define VD_HAL_H__
+
+#include <stdint.h>
+
+#ifndef VD_HOST_SIM
+#define VD_HOST_SIM             0
+#endif
+
+static const int VD_SAMPLE_HZ = 100;        ///< Full sample rate of each channel, one sample period is the time unit
+static const int VD_BLOCK_LEN = 1;          ///< Samples per block handed to the filter
+static const int VD_ADC_TIMEOUT_MS = 100;   ///< vdSensorTask wakes up anyway after this, on top of a sample period
+static const int VD_STANDBY_PERIOD_MS = 250; ///< Sample period in standby, see vdHalStandby()
+static const int VD_STANDBY_DIVIDER = VD_STANDBY_PERIOD_MS * VD_SAMPLE_HZ / 1000;
+
+/* IR sensors, channel 0 is the leftmost one, see vdAdcChannelMap in vd_adc.hpp for the wiring */
+#ifndef VD_IR_CHANNELS
+#define VD_IR_CHANNELS          3
+#endif
+static const int VD_CHANNELS = VD_IR_CHANNELS;
+
+/**
+ * VD_BLOCK_LEN conversions of every IR sensor, channel-major so each channel is
+ * one contiguous row.  The scans are divider sample periods apart, the rate
+ * only changes between two blocks, see vdHalSampleDivider().
+ */
+typedef struct {
+        uint16_t channel[VD_CHANNELS][VD_BLOCK_LEN];
+        uint8_t divider;    ///< Sample periods each scan of the block stands for
+} vdAdcBlock;
+
+/* Bluetooth command frames, see vd_bluetooth.hpp for the wire format */
+static const int VD_BT_MAX_PAYLOAD = 8;
+
+/* command ids, the start/stop values are the bytes the phone app used to send */
+static const uint8_t VD_BT_CMD_STOP = 0;
+static const uint8_t VD_BT_CMD_START = 3;
+
+typedef struct {
+        uint8_t len;                        ///< Bytes in payload, including the command id
+        uint8_t payload[VD_BT_MAX_PAYLOAD]; ///< payload[0] is the command id
+} vdBtCommand;
+
+/* the flight recorder is streamed into VD_LOG_FILES files that are reused in turn */
+static const int VD_LOG_FILES = 8;
+static const uint32_t VD_LOG_FILE_BYTES = 1024 * 1024;  ///< About an hour of records each
+
+/* static RAM of one module, as listed by the vdmem terminal command */
+typedef struct {
+        const char *name;
+        uint32_t bytes;
+} vdRamUse;
+
+/* motor driver PWM outputs */
+enum {
+    VD_PWM_LEFT_FWD,
+    VD_PWM_LEFT_REV,
+    VD_PWM_RIGHT_FWD,
+    VD_PWM_RIGHT_REV,
+    VD_PWM_CHANNELS
+};
+
+static uint32_t vdHalTicks(void);                   ///< Milliseconds since boot
+static void vdHalCycleCounterInit(void);
+static uint32_t vdHalCycles(void);                  ///< Free running CPU cycle counter
+static uint32_t vdHalCyclesPerUs(void);             ///< vdHalCycles() per microsecond
+static void vdHalDelayMs(uint32_t ms);              ///< Sleeps the calling task
+static void vdHalSampleDivider(int divider);        ///< Scans every @param divider sample periods from the next block on
+static const vdAdcBlock* vdAdcGetBlock(void);       ///< Last block of samples, NULL before the first
+static void vdHalPwmSet(int channel, int percent);  ///< Sets the duty cycle of a VD_PWM_* output
+static void vdHalLeds(uint8_t mask);                ///< Sets the four LEDs, bit 0 is LED 1
+static void vdHalBuzzer(bool on);
+static void vdHalDisplay(int number);               ///< Shows a 2-digit number
+static uint8_t vdHalSwitches(void);                 ///< Switch states, bit 0 is switch 1
+static bool vdBluetoothSend(const uint8_t *data, int len);
+static bool vdBluetoothGetCommand(vdBtCommand& cmd, bool wait); ///< Oldest received command, sleeps for one if @param wait
+static bool vdStorageOpen(uint32_t& generation);     ///< Closes the log file and starts the next one
+static bool vdStorageWrite(uint32_t offset, const void *data, int len, bool sync); ///< Writes into the log file, flushes it if @param sync
+static bool vdStorageReadCalibration(void *data, int len); ///< Reads the sensor calibration file, false if there is none
+static bool vdStorageRegisterParams(int *values, const char * const *names, int count); ///< Keeps the values across power cycles
+static void vdHalStandby(bool standby);             ///< Heartbeat sampling with the motors and ADC gated, or full rate
+static void vdHalStandbyWait(uint32_t ms);          ///< Blocks until woken up from standby, at most @param ms unless 0
+static void vdHalWakeUp(void);                      ///< Serves a wake up request now instead of at the next heartbeat
+static int vdHalRam(const vdRamUse **modules);      ///< Static RAM of the backend modules, @returns how many
+
+#if VD_HOST_SIM
+#include "host/vd_hal_host.hpp"
+#else
+#include "vd_hal_lpc.hpp"
+#endif
+
+#endif /* VD_HAL_H__ */
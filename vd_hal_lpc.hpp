@@ -0,0 +1,119 @@
+/**
+ * @file
+ * @brief SJOne (LPC1758) backend of vd_hal.h, include through vd_hal.h only.
+ */
+#ifndef VD_HAL_LPC_HPP_
+#define VD_HAL_LPC_HPP_
+
+#include "io.hpp"
+#include "utilities.h"
+#include "lpc_pwm.hpp"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "vd_adc.hpp"
+#include "vd_bluetooth.hpp"
+#include "vd_storage.hpp"
+#include "vd_power.hpp"
+
+/* motor drivers, indexed by VD_PWM_* */
+static PWM pwmLeftFWD(PWM::pwm2, 1000); // P2.1
+static PWM pwmLeftREV(PWM::pwm3, 1000); // P2.2
+static PWM pwmRightFWD(PWM::pwm4, 1000); // P2.3
+static PWM pwmRightREV(PWM::pwm5, 1000); // P2.4
+static PWM* const vdPwm[VD_PWM_CHANNELS] = { &pwmLeftFWD, &pwmLeftREV, &pwmRightFWD, &pwmRightREV };
+
+static const uint32_t vdBuzzerBit = (1 << 23); // P1.23
+
+static inline uint32_t vdHalTicks(void)
+{
+    return xTaskGetTickCount() * portTICK_PERIOD_MS;
+}
+
+/* DWT cycle counter of the Cortex-M3, also counts while the debugger is detached */
+static inline void vdHalCycleCounterInit(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t vdHalCycles(void)
+{
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t vdHalCyclesPerUs(void)
+{
+    return sys_get_cpu_clock() / 1000000;
+}
+
+static inline void vdHalDelayMs(uint32_t ms)
+{
+    delay_ms(ms);
+}
+
+static inline void vdHalPwmSet(int channel, int percent)
+{
+    vdPwm[channel]->set(percent);
+}
+
+static inline void vdHalLeds(uint8_t mask)
+{
+    LE.setAll(mask);
+}
+
+static inline void vdHalBuzzer(bool on)
+{
+    if(on) {
+        LPC_GPIO1->FIOSET = vdBuzzerBit;
+    }
+    else {
+        LPC_GPIO1->FIOCLR = vdBuzzerBit;
+    }
+}
+
+static inline void vdHalDisplay(int number)
+{
+    LD.setNumber(number);
+}
+
+static inline uint8_t vdHalSwitches(void)
+{
+    return SW.getSwitchValues();
+}
+
+/* decision -> actuation signalling, vdSensorTask notifies vdMotorTask after every decision */
+static TaskHandle_t actuatorTask = 0;
+
+static void vdActuatorRegister(void)
+{
+    actuatorTask = xTaskGetCurrentTaskHandle();
+}
+
+static void vdActuatorSignal(void)
+{
+    if(actuatorTask) {
+        xTaskNotifyGive(actuatorTask);
+    }
+}
+
+/** @returns false if no decision arrived within a sample period plus VD_ADC_TIMEOUT_MS */
+static bool vdActuatorWait(void)
+{
+    return ulTaskNotifyTake(pdTRUE, vdAdcTimeout()) > 0;
+}
+
+/* the FatFs file object holds a sector buffer of its own unless _FS_TINY is set */
+static const vdRamUse vdHalRamModules[] = {
+    { "adc",        sizeof(adcBlock) },
+    { "bluetooth",  sizeof(btRxRing) + sizeof(btTxRing) },
+    { "storage",    sizeof(storageFile) },
+};
+
+static int vdHalRam(const vdRamUse **modules)
+{
+    *modules = vdHalRamModules;
+    return sizeof(vdHalRamModules) / sizeof(vdHalRamModules[0]);
+}
+
+#endif /* VD_HAL_LPC_HPP_ */
@@ -0,0 +1,160 @@
+/**
+ * @file
+ * @brief Sliding-window running median used to normalize the IR sensor channels.
+ *
+ * The window is kept as two binary heaps over the ring of samples: a max-heap
+ * holding the N/2 smallest samples and a min-heap holding the rest.  The median
+ * is the top of the min-heap, which is exactly element [N/2] of the window sorted
+ * in ascending order (what the old per-tick selection sort produced).
+ *
+ * Every update overwrites the oldest sample in place and restores both heaps in
+ * O(log N) compares; reading the median is O(1).
+ *
+ * T stores the samples and must hold every one of them, INDEX the slot numbers
+ * and heap positions with a flag bit to spare, so a window of raw 12-bit counts
+ * shorter than 128 fits in vdRunningMedian<N, uint16_t, uint8_t>.
+ */
+#ifndef VD_MEDIAN_HPP_
+#define VD_MEDIAN_HPP_
+
+#include <stdint.h>
+
+template <int N, typename T = int, typename INDEX = uint16_t>
+class vdRunningMedian
+{
+    public:
+        /** Window starts out full of zeros, same as the old static queues */
+        vdRunningMedian() : mTail(0)
+        {
+            for(int i = 0; i < N; i++) {
+                mValue[i] = 0;
+                if(i < LO_SIZE) {
+                    mLo[i] = i;
+                    mPos[i] = i;
+                }
+                else {
+                    mHi[i - LO_SIZE] = i;
+                    mPos[i] = HI_FLAG | (i - LO_SIZE);
+                }
+            }
+        }
+
+        /**
+         * Replaces the oldest sample of the window with @param value
+         * @returns the new median
+         */
+        int update(int value)
+        {
+            const int slot = mTail;
+            const int old = mValue[slot];
+
+            if(++mTail >= N) {
+                mTail = 0;
+            }
+
+            mValue[slot] = value;
+            if(value == old) {
+                return median();
+            }
+
+            if(mPos[slot] & HI_FLAG) {
+                int p = mPos[slot] & ~HI_FLAG;
+                (value < old) ? hiUp(p) : hiDown(p);
+            }
+            else {
+                int p = mPos[slot];
+                (value > old) ? loUp(p) : loDown(p);
+            }
+
+            /* a sample crossed the median, swap the two heap tops back into order */
+            if(LO_SIZE > 0 && mValue[mLo[0]] > mValue[mHi[0]]) {
+                int lo = mLo[0];
+                int hi = mHi[0];
+                mLo[0] = hi;
+                mPos[hi] = 0;
+                mHi[0] = lo;
+                mPos[lo] = HI_FLAG;
+                loDown(0);
+                hiDown(0);
+            }
+
+            return median();
+        }
+
+        /** @returns the most recently written sample */
+        inline int latest(void) const { return mValue[(mTail ? mTail : N) - 1]; }
+
+        /** @returns element [N/2] of the window in ascending order */
+        inline int median(void) const { return mValue[mHi[0]]; }
+
+    private:
+        static const int LO_SIZE = N / 2;
+        static const int HI_SIZE = N - LO_SIZE;
+        static const int HI_FLAG = 1 << (8 * sizeof(INDEX) - 1);
+        typedef char vdMedianIndexCheck[(N <= HI_FLAG) ? 1 : -1];
+
+        inline void loSet(int p, int slot) { mLo[p] = slot; mPos[slot] = p; }
+        inline void hiSet(int p, int slot) { mHi[p] = slot; mPos[slot] = HI_FLAG | p; }
+
+        /* max-heap of the lower half */
+        void loUp(int p)
+        {
+            const int slot = mLo[p];
+            while(p > 0) {
+                int parent = (p - 1) / 2;
+                if(mValue[mLo[parent]] >= mValue[slot]) break;
+                loSet(p, mLo[parent]);
+                p = parent;
+            }
+            loSet(p, slot);
+        }
+
+        void loDown(int p)
+        {
+            const int slot = mLo[p];
+            for(;;) {
+                int c = 2 * p + 1;
+                if(c >= LO_SIZE) break;
+                if(c + 1 < LO_SIZE && mValue[mLo[c + 1]] > mValue[mLo[c]]) c++;
+                if(mValue[mLo[c]] <= mValue[slot]) break;
+                loSet(p, mLo[c]);
+                p = c;
+            }
+            loSet(p, slot);
+        }
+
+        /* min-heap of the upper half, its top is the median */
+        void hiUp(int p)
+        {
+            const int slot = mHi[p];
+            while(p > 0) {
+                int parent = (p - 1) / 2;
+                if(mValue[mHi[parent]] <= mValue[slot]) break;
+                hiSet(p, mHi[parent]);
+                p = parent;
+            }
+            hiSet(p, slot);
+        }
+
+        void hiDown(int p)
+        {
+            const int slot = mHi[p];
+            for(;;) {
+                int c = 2 * p + 1;
+                if(c >= HI_SIZE) break;
+                if(c + 1 < HI_SIZE && mValue[mHi[c + 1]] < mValue[mHi[c]]) c++;
+                if(mValue[mHi[c]] >= mValue[slot]) break;
+                hiSet(p, mHi[c]);
+                p = c;
+            }
+            hiSet(p, slot);
+        }
+
+        T mValue[N];                ///< Sample ring, indexed by slot
+        INDEX mLo[LO_SIZE + 1];     ///< Max-heap of slots (lower half)
+        INDEX mHi[HI_SIZE];         ///< Min-heap of slots (upper half)
+        INDEX mPos[N];              ///< Heap position of each slot, HI_FLAG set if in mHi
+        INDEX mTail;                ///< Slot holding the oldest sample
+};
+
+#endif /* VD_MEDIAN_HPP_ */
@@ -0,0 +1,87 @@
+/**
+ * @file
+ * @brief Motor output stage, ramps the wheel duties and writes only the PWM channels that change.
+ *
+ * Each wheel is driven by a forward and a reverse PWM channel, channel 2w and
+ * 2w + 1 for wheel w.  The control code sets the signed duty every wheel should
+ * run at on every tick, and update() moves the applied duty towards it :
+ *  - a wheel speeds up by at most one slew step per tick, so a start or a jump of
+ *    the controller output does not draw a current spike;
+ *  - it slows down at once, so a stop or a pause is never delayed;
+ *  - a reversal holds the wheel stopped for one tick, so the forward and the
+ *    reverse channel of a wheel are never on in the same tick and the motor is
+ *    not driven against its own back-EMF at full duty.
+ *
+ * update() reports which channels changed, the caller writes only those.
+ */
+#ifndef VD_MOTOR_HPP_
+#define VD_MOTOR_HPP_
+
+#include <stdint.h>
+
+template <int WHEELS>
+class vdMotorOutput
+{
+    public:
+        vdMotorOutput() : mStarted(false)
+        {
+            for(int w = 0; w < WHEELS; w++) {
+                mTarget[w] = 0;
+                mApplied[w] = 0;
+            }
+        }
+
+        /** Sets the % duty @param wheel should run at, negative is reverse */
+        inline void set(int wheel, int duty) { mTarget[wheel] = duty; }
+
+        /**
+         * One tick of the ramps, a wheel speeds up by at most @param step % duty
+         * @returns a mask of the channels whose duty changed, all of them the first time
+         */
+        uint32_t update(int step)
+        {
+            uint32_t changed = mStarted ? 0 : (1u << (2 * WHEELS)) - 1;
+
+            for(int w = 0; w < WHEELS; w++) {
+                const int last = mApplied[w];
+                const int target = mTarget[w];
+                int next;
+
+                if((last > 0 && target < 0) || (last < 0 && target > 0)) {
+                    next = 0;
+                }
+                else if(target > 0) {
+                    next = (target > last + step) ? last + step : target;
+                }
+                else if(target < 0) {
+                    next = (target < last - step) ? last - step : target;
+                }
+                else {
+                    next = 0;
+                }
+
+                mApplied[w] = next;
+                changed |= (uint32_t)((next > 0 ? next : 0) != (last > 0 ? last : 0)) << (2 * w);
+                changed |= (uint32_t)((next < 0 ? -next : 0) != (last < 0 ? -last : 0)) << (2 * w + 1);
+            }
+            mStarted = true;
+            return changed;
+        }
+
+        /** @returns the % duty of PWM @param channel */
+        inline int duty(int channel) const
+        {
+            const int applied = mApplied[channel >> 1];
+            return (channel & 1) ? ((applied < 0) ? -applied : 0) : ((applied > 0) ? applied : 0);
+        }
+
+        /** @returns the signed % duty @param wheel runs at */
+        inline int applied(int wheel) const { return mApplied[wheel]; }
+
+    private:
+        int mTarget[WHEELS];
+        int mApplied[WHEELS];
+        bool mStarted;          ///< The channels were written once, their state at power up is not assumed
+};
+
+#endif /* VD_MOTOR_HPP_ */
@@ -0,0 +1,117 @@
+/**
+ * @file
+ * @brief Tunable parameters of the vd control code.
+ *
+ * Everything that was tuned by hand on the floor and does not size a buffer:
+ * motor trims, zone bounds, speed levels, controller gains and the motor ramp.  The defaults are
+ * the hand-tuned values.  The filter window is a template argument of the
+ * filters (vd_filter.hpp) and stays a build setting.
+ *
+ * Plain integers only, so a parameter set can be copied, compared and stored
+ * as is.  host/vd_sweep searches this space in the simulator, the vdparam
+ * terminal command changes them on the robot and keeps them as disk telemetry.
+ */
+#ifndef VD_PARAMS_HPP_
+#define VD_PARAMS_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const int VD_ZONE_BOUNDS = 4;
+
+/* index of each speed level in vdParams::speed */
+enum {
+    VD_SPEED_SLOW,
+    VD_SPEED_MEDIUM,
+    VD_SPEED_FAST,
+    VD_SPEED_LEVELS
+};
+
+typedef struct {
+        int leftError;                  ///< % duty added to the left motor whenever it runs, it is the weaker one
+        int rightError;
+        int zoneBound[VD_ZONE_BOUNDS];  ///< mm, farthest distance of VD_ZONE_TOO_FAR .. VD_ZONE_CLOSE, see vdZoneOf()
+        int targetDist;                 ///< mm, middle distance to keep the target at, inside VD_ZONE_IN_RANGE
+        int speed[VD_SPEED_LEVELS];     ///< % duty, fast limits the distance loop and medium the bearing loop
+        int distanceKp;                 ///< Distance PID gains in 1/1000 % duty per mm, see vd_pid.hpp
+        int distanceKi;
+        int distanceKd;
+        int bearingKp;                  ///< Bearing PID gains, the bearing is right - left in mm
+        int bearingKd;
+        int motorSlew;                  ///< % duty per second a wheel may speed up by, see vd_motor.hpp
+} vdParams;
+
+static const vdParams VD_PARAMS_DEFAULT = {
+    15, 0,
+    { 760, 440, 260, 110 },
+    180,
+    { 35, 50, 70 },                 // VD_SLOW, VD_MEDIUM, VD_FAST
+    1000, 20, 5000,
+    50, 250,
+    1000,
+};
+
+static const int VD_PARAMS_COUNT = sizeof(vdParams) / sizeof(int);
+
+/** Index of @param field in a vdParams seen as VD_PARAMS_COUNT ints, e.g. VD_PARAM_INDEX(speed[VD_SPEED_FAST]) */
+#define VD_PARAM_INDEX(field)   (offsetof(vdParams, field) / sizeof(int))
+
+/* every int of vdParams in order */
+static const char * const vdParamNames[] = {
+    "leftError", "rightError",
+    "zoneBound0", "zoneBound1", "zoneBound2", "zoneBound3",
+    "targetDist",
+    "speedSlow", "speedMedium", "speedFast",
+    "distanceKp", "distanceKi", "distanceKd",
+    "bearingKp", "bearingKd",
+    "motorSlew",
+};
+typedef char vdParamNamesCheck[(sizeof(vdParamNames) / sizeof(vdParamNames[0]) == VD_PARAMS_COUNT) ? 1 : -1];
+
+/* limits of vdParamsCheck() */
+static const int VD_PARAMS_MAX_ERROR = 50;      ///< % duty
+static const int VD_PARAMS_MAX_MM = 1000;       ///< Farther than the calibration reaches, see VD_CAL_MAX_MM
+static const int VD_PARAMS_MAX_GAINS = 30000;   ///< Sum of the gains of a loop in 1/1000, see vd_pid.hpp
+static const int VD_PARAMS_MAX_SLEW = 10000;    ///< % duty per second, full duty in 10 ms
+
+/** @returns -1 if @param p is usable, else the index of the first value out of range */
+static int vdParamsCheck(const vdParams *p)
+{
+    const int maxError = (p->leftError > p->rightError) ? p->leftError : p->rightError;
+    int i;
+
+    if(p->leftError < 0 || p->leftError > VD_PARAMS_MAX_ERROR) {
+        return VD_PARAM_INDEX(leftError);
+    }
+    if(p->rightError < 0 || p->rightError > VD_PARAMS_MAX_ERROR) {
+        return VD_PARAM_INDEX(rightError);
+    }
+    /* the zones nest, each bound closer than the one before */
+    for(i = 0; i < VD_ZONE_BOUNDS; i++) {
+        if(p->zoneBound[i] <= 0 || p->zoneBound[i] > VD_PARAMS_MAX_MM || (i > 0 && p->zoneBound[i] >= p->zoneBound[i - 1])) {
+            return VD_PARAM_INDEX(zoneBound[0]) + i;
+        }
+    }
+    if(p->targetDist <= p->zoneBound[VD_ZONE_BOUNDS - 1] || p->targetDist > p->zoneBound[VD_ZONE_BOUNDS - 2]) {
+        return VD_PARAM_INDEX(targetDist);
+    }
+    /* the trims are added on top of the speeds */
+    for(i = 0; i < VD_SPEED_LEVELS; i++) {
+        if(p->speed[i] <= 0 || p->speed[i] > 100 - maxError || (i > 0 && p->speed[i] < p->speed[i - 1])) {
+            return VD_PARAM_INDEX(speed[0]) + i;
+        }
+    }
+    if(p->distanceKp < 0 || p->distanceKi < 0 || p->distanceKd < 0 ||
+       p->distanceKp + p->distanceKi + p->distanceKd > VD_PARAMS_MAX_GAINS) {
+        return VD_PARAM_INDEX(distanceKp);
+    }
+    if(p->bearingKp < 0 || p->bearingKd < 0 || p->bearingKp + p->bearingKd > VD_PARAMS_MAX_GAINS) {
+        return VD_PARAM_INDEX(bearingKp);
+    }
+    if(p->motorSlew <= 0 || p->motorSlew > VD_PARAMS_MAX_SLEW) {
+        return VD_PARAM_INDEX(motorSlew);
+    }
+    return -1;
+}
+
+#endif /* VD_PARAMS_HPP_ */
@@ -0,0 +1,118 @@
+/**
+ * @file
+ * @brief Fixed-point PID controller for the vd motor outputs, no FPU needed.
+ *
+ * Gains are Q16.16 (VD_PID_ONE is 1.0) per count of error, and the output is in
+ * percent of PWM duty.  The derivative acts on the measurement rather than the
+ * error, so a change of setpoint does not kick the output.  Anti-windup is done
+ * twice: the integral is clamped to the output limits, and it stops growing in
+ * the direction the output is already saturated.
+ *
+ * The gains are per update at the full rate.  When the updates come several of
+ * those periods apart (setPeriods()) the integral grows by that many steps and
+ * the derivative is taken per period, so the loop keeps its response in time.
+ *
+ * The derivative input is in 1/256 of a count per period (Q8), so a slow change
+ * of a fraction of a count per period is not rounded away.
+ *
+ * update() is straight-line code, so its cost per sample is constant: a few
+ * multiplies, and one divide by the periods for the derivative of the two
+ * argument form.  The integral step, which also scales by the periods, and the
+ * derivative term are computed in 64 bits.  The other 32-bit intermediates
+ * cannot overflow as long as the largest error times the sum of Kp and Ki stays
+ * below 32768, e.g. errors up to +-1000 mm with gains that add up to less than 32.0.
+ */
+#ifndef VD_PID_HPP_
+#define VD_PID_HPP_
+
+#include <stdint.h>
+
+static const int32_t VD_PID_ONE = (1 << 16);
+
+/** Converts a gain given in 1/1000 to Q16.16 at compile time */
+#define VD_PID_GAIN(milli)      ((int32_t)(((int64_t)(milli) * VD_PID_ONE) / 1000))
+
+class vdPid
+{
+    public:
+        vdPid(int32_t kp, int32_t ki, int32_t kd, int outMin, int outMax) : mPeriods(1)
+        {
+            reset();
+            setGains(kp, ki, kd, outMin, outMax);
+        }
+
+        /** Changes the gains and output limits, the integral is kept but clamped to the new limits */
+        void setGains(int32_t kp, int32_t ki, int32_t kd, int outMin, int outMax)
+        {
+            const int32_t min = (int32_t) outMin << 16;
+            const int32_t max = (int32_t) outMax << 16;
+
+            mKp = kp;
+            mKi = ki;
+            mKd = kd;
+            mOutMin = outMin;
+            mOutMax = outMax;
+            mIntegral = (mIntegral < min) ? min : (mIntegral > max) ? max : mIntegral;
+        }
+
+        /** The next updates come @param periods full-rate periods apart */
+        inline void setPeriods(int periods) { mPeriods = periods; }
+
+        /** Forgets the integral and the last measurement, call when the loop is (re)closed */
+        void reset(void)
+        {
+            mIntegral = 0;
+            mLast = 0;
+            mPrimed = false;
+        }
+
+        /** @returns the new output for @param measurement, which should be at @param setpoint */
+        int update(int setpoint, int measurement)
+        {
+            return update(setpoint, measurement, mPrimed ? (measurement - mLast) * 256 / mPeriods : 0);
+        }
+
+        /**
+         * Same with the change of the measurement per full-rate period given in
+         * @param delta, in 1/256 of a count, for a caller that has a better estimate
+         * than the difference of two filtered values, e.g. a tracker's rate.
+         */
+        int update(int setpoint, int measurement, int delta)
+        {
+            const int32_t error = setpoint - measurement;
+            const int32_t min = (int32_t) mOutMin << 16;
+            const int32_t max = (int32_t) mOutMax << 16;
+
+            mLast = measurement;
+            mPrimed = true;
+
+            const int64_t step = (int64_t) mIntegral + (int64_t) mKi * error * mPeriods;
+            const int32_t integral = (step < min) ? min : (step > max) ? max : (int32_t) step;
+
+            int32_t out = mKp * error + integral - (int32_t)(((int64_t) mKd * delta) >> 8);
+            if(out > max) {
+                out = max;
+                if(error < 0) mIntegral = integral; // only let it unwind
+            }
+            else if(out < min) {
+                out = min;
+                if(error > 0) mIntegral = integral;
+            }
+            else {
+                mIntegral = integral;
+            }
+
+            /* round to the nearest percent, >> of a negative value is arithmetic on gcc */
+            return (out + (1 << 15)) >> 16;
+        }
+
+    private:
+        int32_t mKp, mKi, mKd;          ///< Q16.16
+        int mOutMin, mOutMax;
+        int32_t mIntegral;              ///< Q16.16, already scaled by mKi
+        int mLast;
+        int mPeriods;                   ///< Full-rate periods between two updates
+        bool mPrimed;
+};
+
+#endif /* VD_PID_HPP_ */
@@ -0,0 +1,81 @@
+/**
+ * @file
+ * @brief Standby of the SJOne backend while the dog is paused.
+ *
+ * vdHalStandby(true) drops the sensor sampling to a heartbeat (vdAdcStandby()),
+ * parks the motor PWM pins low and gates the PWM1 clock, and clears
+ * VD_POWER_RUN_BIT so that the polling vd tasks block in vdHalStandbyWait()
+ * instead of waking up every few ms.  Only TIMER2 (the heartbeat), UART2 (a
+ * Bluetooth start) and the switch poll are left to wake the core.
+ *
+ * With every vd task blocked, FreeRTOS tickless idle (configUSE_TICKLESS_IDLE 1
+ * in FreeRTOSConfig.h) stops the tick and sleeps in WFI until the next of those.
+ *
+ * Part of the SJOne backend, include through vd_hal.h only.
+ */
+#ifndef VD_POWER_HPP_
+#define VD_POWER_HPP_
+
+#include "LPC17xx.h"
+#include "FreeRTOS.h"
+#include "event_groups.h"
+
+static const EventBits_t VD_POWER_RUN_BIT = (1 << 0);  ///< Set while the dog is awake
+static const uint32_t VD_PWM_PINS = (0xF << 1);         ///< P2.1 .. P2.4, PWM1.2 .. PWM1.5
+static const uint32_t VD_PWM_PINSEL = (0x55 << 2);      ///< Function 1 of those pins in PINSEL4
+
+static EventGroupHandle_t powerEvents = 0;
+
+/** Creates the standby event, awake, before the scheduler starts */
+static void vdPowerInit(void)
+{
+    powerEvents = xEventGroupCreate();
+    xEventGroupSetBits(powerEvents, VD_POWER_RUN_BIT);
+}
+
+/**
+ * A gated PWM block freezes its outputs wherever they are, so the pins are
+ * handed to GPIO and driven low before the clock is stopped.
+ */
+static void vdPwmPark(bool park)
+{
+    if(park) {
+        LPC_GPIO2->FIOCLR = VD_PWM_PINS;
+        LPC_GPIO2->FIODIR |= VD_PWM_PINS;
+        LPC_PINCON->PINSEL4 &= ~(VD_PWM_PINSEL | (VD_PWM_PINSEL << 1));
+        LPC_SC->PCONP &= ~(1 << 6);
+    }
+    else {
+        LPC_SC->PCONP |= (1 << 6);
+        LPC_PINCON->PINSEL4 = (LPC_PINCON->PINSEL4 & ~(VD_PWM_PINSEL << 1)) | VD_PWM_PINSEL;
+    }
+}
+
+/** Enters standby if @param standby, the motor duties must be 0 by then, else wakes everything up */
+static void vdHalStandby(bool standby)
+{
+    if(standby) {
+        xEventGroupClearBits(powerEvents, VD_POWER_RUN_BIT);
+        vdPwmPark(true);
+        vdAdcStandby(true);
+    }
+    else {
+        vdAdcStandby(false);
+        vdPwmPark(false);
+        xEventGroupSetBits(powerEvents, VD_POWER_RUN_BIT);
+    }
+}
+
+/** Blocks until the dog wakes up, or at most @param ms if it is not 0 */
+static void vdHalStandbyWait(uint32_t ms)
+{
+    xEventGroupWaitBits(powerEvents, VD_POWER_RUN_BIT, pdFALSE, pdTRUE, ms ? ms / portTICK_PERIOD_MS : portMAX_DELAY);
+}
+
+/** Cuts the heartbeat short so a wake up request is served now */
+static void vdHalWakeUp(void)
+{
+    vdAdcKick();
+}
+
+#endif /* VD_POWER_HPP_ */
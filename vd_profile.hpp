@@ -0,0 +1,145 @@
+/**
+ * @file
+ * @brief Cycle-accurate probes around the vd hot path stages.
+ *
+ * Put VD_PROBE(stage) at the top of a function to time it until it returns.
+ * Each stage keeps min/max and a histogram with two buckets per power of two
+ * of the cycle count (the Cortex-M3 DWT cycle counter on the board), from which
+ * p50/p99 are estimated to within 50 %.  A stage is only ever recorded by one
+ * task; resets are requested by other tasks and applied by the recorder.
+ *
+ * Setting VD_ENABLE_PROFILING to 0 compiles every probe out.
+ */
+#ifndef VD_PROFILE_HPP_
+#define VD_PROFILE_HPP_
+
+#include <stdint.h>
+
+#ifndef VD_ENABLE_PROFILING
+#define VD_ENABLE_PROFILING     1
+#endif
+
+enum vdProfileStage {
+    VD_PROF_FILTER,         ///< vdNormalizeSensorValues()
+    VD_PROF_DECIDE,         ///< vdReadSensor()
+    VD_PROF_MOTOR,          ///< vdRunMotor()
+    VD_PROF_CONTROL,        ///< vdControl(), part of vdRunMotor()
+    VD_PROF_TELEMETRY,      ///< vdBluetoothTx()
+    VD_PROF_STAGES
+};
+
+static const char * const vdProfileStageNames[VD_PROF_STAGES] = { "filter", "decide", "motor", "control", "telemetry" };
+
+static const int VD_PROF_BUCKETS = 48;  ///< Up to 2^24 cycles, the last bucket also takes anything longer
+
+typedef struct {
+        uint32_t count;
+        uint32_t min;
+        uint32_t max;
+        uint32_t bucket[VD_PROF_BUCKETS];
+        volatile bool resetPending;
+} vdProfileStats;
+
+#if VD_ENABLE_PROFILING
+
+static vdProfileStats vdProfile[VD_PROF_STAGES];
+
+static inline int vdProfileBucket(uint32_t cycles)
+{
+    if(cycles < 2) {
+        return cycles;
+    }
+    const int octave = 31 - __builtin_clz(cycles);
+    const int index = 2 * octave + ((cycles >> (octave - 1)) & 1);
+    return (index < VD_PROF_BUCKETS) ? index : VD_PROF_BUCKETS - 1;
+}
+
+/** @returns the smallest cycle count that falls in the bucket after @param index */
+static inline uint32_t vdProfileBucketLimit(int index)
+{
+    if(index < 2) {
+        return index + 1;
+    }
+    const int octave = index / 2;
+    return (uint32_t)(3 + (index & 1)) << (octave - 1);
+}
+
+static void vdProfileClear(vdProfileStats *s)
+{
+    int i;
+    s->count = 0;
+    s->min = 0xFFFFFFFF;
+    s->max = 0;
+    for(i = 0; i < VD_PROF_BUCKETS; i++) {
+        s->bucket[i] = 0;
+    }
+}
+
+static void vdProfileRecord(int stage, uint32_t cycles)
+{
+    vdProfileStats *s = &vdProfile[stage];
+
+    if(s->resetPending || 0 == s->count) {
+        vdProfileClear(s);
+        s->resetPending = false;
+    }
+    s->count++;
+    if(cycles < s->min) s->min = cycles;
+    if(cycles > s->max) s->max = cycles;
+    s->bucket[vdProfileBucket(cycles)]++;
+}
+
+/** Scoped probe, records the cycles between construction and destruction */
+class vdProbe
+{
+    public:
+        vdProbe(int stage) : mStage(stage), mStart(vdHalCycles()) { }
+        ~vdProbe() { vdProfileRecord(mStage, vdHalCycles() - mStart); }
+
+    private:
+        const int mStage;
+        const uint32_t mStart;
+};
+
+#define VD_PROBE(stage)         vdProbe vdProbe_##stage(stage)
+
+static inline void vdProfileInit(void)
+{
+    vdHalCycleCounterInit();
+}
+
+/** @returns an upper bound of the cycle count below which @param percent of the samples fall */
+static inline uint32_t vdProfilePercentile(const vdProfileStats *s, int percent)
+{
+    const uint32_t want = (uint64_t) s->count * percent / 100;
+    uint32_t seen = 0;
+    int i;
+
+    for(i = 0; i < VD_PROF_BUCKETS; i++) {
+        seen += s->bucket[i];
+        if(seen > want) {
+            uint32_t limit = vdProfileBucketLimit(i) - 1;
+            return (limit < s->max) ? limit : s->max;
+        }
+    }
+    return s->max;
+}
+
+/** Asks every stage to start over with its next sample */
+static inline void vdProfileReset(void)
+{
+    int i;
+    for(i = 0; i < VD_PROF_STAGES; i++) {
+        vdProfile[i].resetPending = true;
+    }
+}
+
+#else
+
+#define VD_PROBE(stage)
+static inline void vdProfileInit(void) { }
+static inline void vdProfileReset(void) { }
+
+#endif /* VD_ENABLE_PROFILING */
+
+#endif /* VD_PROFILE_HPP_ */
@@ -0,0 +1,51 @@
+/**
+ * @file
+ * @brief Sample rate governor of the vd sensing and decision loop.
+ *
+ * A target standing still in range needs far fewer readings than one the dog
+ * is turning after.  Each tick reports whether anything is going on, and the
+ * governor returns the sample divider to run at :
+ *  - anything going on bursts back to full rate at once;
+ *  - HOLD calm sample periods in a row halve the rate, down to one scan every
+ *    MAX_DIVIDER periods.
+ *
+ * The rate is VD_SAMPLE_HZ divided by a whole number, so every scan stands for
+ * a whole number of sample periods and the tracker, the PIDs and the motor
+ * ramps keep their response in time (see vdTracker, vdPid::setPeriods()).
+ * The filters see one sample per scan, see vdFilterBank.
+ */
+#ifndef VD_RATE_HPP_
+#define VD_RATE_HPP_
+
+template <int MAX_DIVIDER, int HOLD>
+class vdRateGovernor
+{
+    public:
+        vdRateGovernor() : mDivider(1), mCalm(0) { }
+
+        /**
+         * One tick that spanned @param periods sample periods, @param busy if the
+         * readings or the state are changing
+         * @returns the divider to sample at from now on
+         */
+        int update(bool busy, int periods)
+        {
+            if(busy) {
+                mDivider = 1;
+                mCalm = 0;
+            }
+            else if((mCalm += periods) >= HOLD && mDivider < MAX_DIVIDER) {
+                mDivider = (2 * mDivider < MAX_DIVIDER) ? 2 * mDivider : MAX_DIVIDER;
+                mCalm = 0;
+            }
+            return mDivider;
+        }
+
+        inline int divider(void) const { return mDivider; }
+
+    private:
+        int mDivider;
+        int mCalm;      ///< Sample periods since the last halving or burst
+};
+
+#endif /* VD_RATE_HPP_ */
@@ -0,0 +1,301 @@
+/**
+ * @file
+ * @brief Always-on flight recorder of the vd decisions, packed into 16-bit words.
+ *
+ * The recorder is a ring of BLOCKS blocks of VD_REC_BLOCK_WORDS words.  Every block
+ * starts with its sequence number and a 32-bit timestamp, followed by records :
+ *
+ * @code
+ *     full  : |01 state:4 dt_ms:10| speed:4 left:12 | spare:1 speed:3 middle:12 | flags:4 right:12 |
+ *     delta : |1 dt:3 dleft:4 dmiddle:4 dright:4|
+ *     end   : |0000 0000 0000 0000|
+ * @endcode
+ *
+ * A delta record (two bytes instead of eight) is used when state, speed and flags
+ * did not change, the time step is a whole number of up to 7 PERIOD_MS periods and
+ * every reading moved by -8..7.  Anything else is a full record, and a record that
+ * does not fit in the block, or whose dt does not fit in 10 bits, opens the next
+ * block and overwrites the oldest one.  Each block can therefore be decoded on its
+ * own, and a reader that gets lapped only loses whole blocks.
+ *
+ * There is one writer, the sensor task.  drain() decodes for one reader, the vdlog
+ * terminal command, and copyBlock() hands finished blocks to any other reader such
+ * as vdLogger().  Readers copy a block, then check that its sequence number did not
+ * change, so reading never blocks or slows down the writer.
+ *
+ * vdLogger() stores the blocks as they are, VD_LOG_CHUNK_BLOCKS at a time, the first
+ * of which is replaced by a vdLogHeader.  host/vd_log_dump decodes those files.
+ *
+ * Setting VD_RECORDER_DELTA to 0 writes only full records.
+ */
+#ifndef VD_RECORDER_HPP_
+#define VD_RECORDER_HPP_
+
+#include <stdint.h>
+#include <string.h>
+#include "vd_barrier.h"
+
+#ifndef VD_RECORDER_DELTA
+#define VD_RECORDER_DELTA       1
+#endif
+
+static const int VD_REC_BLOCK_WORDS = 32;   ///< 64 bytes, 3 header words and up to 14 full or 29 delta records
+static const int VD_REC_HEADER_WORDS = 3;
+
+static const uint8_t VD_REC_PAUSED = (1 << 0); ///< vdFlightRecord::flags
+
+/* vdFlightRecorder::copyBlock() results */
+enum { VD_REC_BLOCK_LOST = -1, VD_REC_BLOCK_PENDING, VD_REC_BLOCK_COPIED };
+
+static const int VD_LOG_CHUNK_BLOCKS = 16;  ///< Blocks per storage write, 1 KB or two SD sectors
+static const char VD_LOG_MAGIC[4] = { 'V', 'D', 'L', 'G' };
+
+/** Takes the place of the first block of every chunk written to storage */
+typedef struct {
+        char magic[4];          ///< VD_LOG_MAGIC
+        uint32_t generation;    ///< Number of the file, one more than the file before it
+        uint32_t chunk;         ///< Index of this chunk in the file
+        uint32_t lost;          ///< Blocks the logger missed since boot
+        uint16_t blockWords;    ///< VD_REC_BLOCK_WORDS
+        uint16_t periodMs;      ///< Time unit of the delta records
+        uint8_t reserved[44];
+} vdLogHeader;
+
+/* compile error here means vdLogHeader no longer is the size of a block */
+typedef char vdLogHeaderSizeCheck[(sizeof(vdLogHeader) == VD_REC_BLOCK_WORDS * sizeof(uint16_t)) ? 1 : -1];
+
+/** One decoded record */
+typedef struct {
+        uint32_t timestamp;     ///< vdHalTicks() of the sensor reading
+        uint16_t left;          ///< Filtered distances in mm the decision was made on
+        uint16_t middle;
+        uint16_t right;
+        uint8_t state;          ///< vdState after the decision
+        uint8_t speed;          ///< Duty on the faster wheel, 0-100 %, see vdAppliedDuty()
+        uint8_t flags;          ///< VD_REC_*
+} vdFlightRecord;
+
+template <int BLOCKS, int PERIOD_MS>
+class vdFlightRecorder
+{
+        /* compile error here means there are not enough blocks to write one while reading another */
+        typedef char vdRecorderSizeCheck[(BLOCKS >= 2) ? 1 : -1];
+
+    public:
+        vdFlightRecorder() : mWriteSeq(0), mWritePos(VD_REC_BLOCK_WORDS), mReadSeq(0), mReadPos(0)
+        {
+            memset((void*) mBlock, 0, sizeof(mBlock));
+            memset(&mLast, 0, sizeof(mLast));
+            memset(&mReadLast, 0, sizeof(mReadLast));
+        }
+
+        /** Appends @param rec (single writer only) */
+        void write(const vdFlightRecord& rec)
+        {
+            const uint32_t dt = rec.timestamp - mLast.timestamp;
+
+#if VD_RECORDER_DELTA
+            if(mWriteSeq != 0 && mWritePos < VD_REC_BLOCK_WORDS &&
+               rec.state == mLast.state && rec.speed == mLast.speed && rec.flags == mLast.flags &&
+               dt % PERIOD_MS == 0 && dt / PERIOD_MS <= 7) {
+                const int dl = rec.left - mLast.left;
+                const int dm = rec.middle - mLast.middle;
+                const int dr = rec.right - mLast.right;
+
+                if(fitsNibble(dl) && fitsNibble(dm) && fitsNibble(dr)) {
+                    current()[mWritePos++] = 0x8000 | ((dt / PERIOD_MS) << 12) |
+                                             ((dl & 0xF) << 8) | ((dm & 0xF) << 4) | (dr & 0xF);
+                    mLast = rec;
+                    return;
+                }
+            }
+#endif
+
+            if(mWriteSeq == 0 || mWritePos + 4 > VD_REC_BLOCK_WORDS || dt > 0x3FF) {
+                openBlock(rec.timestamp);
+                mLast.timestamp = rec.timestamp;
+            }
+
+            /* the first word goes last, a reader stops at the end marker until then */
+            volatile uint16_t *w = &current()[mWritePos];
+            w[1] = ((rec.speed & 0xF) << 12) | (rec.left & 0xFFF);
+            w[2] = (((rec.speed >> 4) & 0x7) << 12) | (rec.middle & 0xFFF);
+            w[3] = ((rec.flags & 0xF) << 12) | (rec.right & 0xFFF);
+            vdMemoryBarrier();
+            w[0] = 0x4000 | ((rec.state & 0xF) << 10) | ((rec.timestamp - mLast.timestamp) & 0x3FF);
+            mWritePos += 4;
+            mLast = rec;
+        }
+
+        /**
+         * Decodes up to @param max records the reader has not seen yet into @param out,
+         * oldest first (single reader only).  @param lost is incremented by the number of
+         * blocks that were overwritten before they could be read.
+         * @returns the number of records decoded, less than @param max once caught up
+         */
+        int drain(vdFlightRecord *out, int max, uint32_t *lost)
+        {
+            uint16_t block[VD_REC_BLOCK_WORDS];
+            int n = 0;
+
+            while(n < max) {
+                const uint32_t head = mWriteSeq;
+                if(0 == head) {
+                    break;
+                }
+
+                /* start from, or skip forward to, the oldest block that is not about to be reused */
+                const uint32_t oldest = oldestSeq(head);
+                if(0 == mReadSeq || mReadSeq < oldest) {
+                    if(mReadSeq != 0) {
+                        *lost += oldest - mReadSeq;
+                    }
+                    mReadSeq = oldest;
+                    mReadPos = 0;
+                }
+
+                if(!copy(mReadSeq, block)) {
+                    if(mReadSeq == mWriteSeq) {
+                        break; // opened but the header is not written yet
+                    }
+                    continue; // the writer lapped us during the copy, start over from the oldest block
+                }
+
+                int pos = mReadPos;
+                if(0 == pos) {
+                    mReadLast.timestamp = blockTimestamp(block);
+                    pos = VD_REC_HEADER_WORDS;
+                }
+                while(n < max && pos < VD_REC_BLOCK_WORDS && block[pos] != 0) {
+                    pos += decode(&block[pos], mReadLast);
+                    out[n++] = mReadLast;
+                }
+                mReadPos = pos;
+
+                if(n < max) {
+                    if(mReadSeq == head) {
+                        break; // caught up with the block being written
+                    }
+                    mReadSeq++;
+                    mReadPos = 0;
+                }
+            }
+            return n;
+        }
+
+        /**
+         * Copies the raw words of block @param seq to @param out once it is complete,
+         * without touching the drain() position, so it can be used by a second reader.
+         * @returns VD_REC_BLOCK_COPIED, or VD_REC_BLOCK_PENDING while it is still being
+         *          written, or VD_REC_BLOCK_LOST if it has been reused since
+         */
+        int copyBlock(uint32_t seq, uint16_t *out) const
+        {
+            const uint32_t head = mWriteSeq;
+
+            if(0 == seq || seq >= head) {
+                return VD_REC_BLOCK_PENDING;
+            }
+            if(seq < oldestSeq(head) || !copy(seq, out)) {
+                return VD_REC_BLOCK_LOST;
+            }
+            return VD_REC_BLOCK_COPIED;
+        }
+
+        /** @returns the sequence number of the block being written, 0 before the first record */
+        inline uint32_t sequence(void) const { return mWriteSeq; }
+
+        /** @returns the oldest block copyBlock() can still return */
+        inline uint32_t oldest(void) const { return oldestSeq(mWriteSeq); }
+
+        /** @returns the number of bytes the records take */
+        static int size(void) { return sizeof(uint16_t) * BLOCKS * VD_REC_BLOCK_WORDS; }
+
+        /** @returns the timestamp in the header of @param block, the base of its first record */
+        static inline uint32_t blockTimestamp(const uint16_t *block)
+        {
+            return block[1] | ((uint32_t) block[2] << 16);
+        }
+
+        /** @returns the sequence number tag in the header of block @param seq */
+        static inline uint16_t seqTag(uint32_t seq) { return 0x8000 | (seq & 0x7FFF); }
+
+        /** Applies the record at @param w to @param rec, @returns its length in words */
+        static int decode(const uint16_t *w, vdFlightRecord& rec)
+        {
+            if(w[0] & 0x8000) {
+                rec.timestamp += ((w[0] >> 12) & 0x7) * PERIOD_MS;
+                rec.left += signNibble((w[0] >> 8) & 0xF);
+                rec.middle += signNibble((w[0] >> 4) & 0xF);
+                rec.right += signNibble(w[0] & 0xF);
+                return 1;
+            }
+            rec.timestamp += w[0] & 0x3FF;
+            rec.state = (w[0] >> 10) & 0xF;
+            rec.speed = (w[1] >> 12) | (((w[2] >> 12) & 0x7) << 4);
+            rec.flags = w[3] >> 12;
+            rec.left = w[1] & 0xFFF;
+            rec.middle = w[2] & 0xFFF;
+            rec.right = w[3] & 0xFFF;
+            return 4;
+        }
+
+    private:
+        static inline bool fitsNibble(int d) { return d >= -8 && d <= 7; }
+        static inline int signNibble(int n) { return (n & 0x8) ? n - 16 : n; }
+
+        /** @returns the oldest block that is not about to be reused while @param head is written */
+        static inline uint32_t oldestSeq(uint32_t head)
+        {
+            return (head + 2 > (uint32_t) BLOCKS) ? head + 2 - BLOCKS : 1;
+        }
+
+        /** Copies block @param seq to @param out, @returns false if it was not that block throughout */
+        bool copy(uint32_t seq, uint16_t *out) const
+        {
+            const volatile uint16_t *b = mBlock[seq % BLOCKS];
+            const uint16_t tag = seqTag(seq);
+            int i;
+
+            if(b[0] != tag) {
+                return false;
+            }
+            vdMemoryBarrier();
+            for(i = 0; i < VD_REC_BLOCK_WORDS; i++) {
+                out[i] = b[i];
+            }
+            vdMemoryBarrier();
+            return b[0] == tag;
+        }
+
+        inline volatile uint16_t* current(void) { return mBlock[mWriteSeq % BLOCKS]; }
+
+        void openBlock(uint32_t timestamp)
+        {
+            volatile uint16_t *b = mBlock[(mWriteSeq + 1) % BLOCKS];
+            int i;
+
+            b[0] = 0; // invalidate first so a reader copying this block notices
+            vdMemoryBarrier();
+            for(i = 1; i < VD_REC_BLOCK_WORDS; i++) {
+                b[i] = 0;
+            }
+            b[1] = timestamp & 0xFFFF;
+            b[2] = timestamp >> 16;
+            vdMemoryBarrier();
+            mWriteSeq++;
+            b[0] = seqTag(mWriteSeq);
+            mWritePos = VD_REC_HEADER_WORDS;
+        }
+
+        volatile uint16_t mBlock[BLOCKS][VD_REC_BLOCK_WORDS];
+        volatile uint32_t mWriteSeq;    ///< Sequence number of the block being written, blocks start at 1
+        int mWritePos;                  ///< Next free word of that block
+        vdFlightRecord mLast;           ///< Last record written, base of the next delta
+
+        uint32_t mReadSeq;              ///< Block the reader is in, 0 before the first drain
+        int mReadPos;                   ///< Next word to decode in it, 0 for the header
+        vdFlightRecord mReadLast;       ///< Last record decoded
+};
+
+#endif /* VD_RECORDER_HPP_ */
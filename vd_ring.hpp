@@ -0,0 +1,60 @@
+/**
+ * @file
+ * @brief Lock-free single producer / single consumer ring buffer.
+ *
+ * One side (typically an ISR) only pushes and the other side only pops, so the
+ * head and tail indexes each have a single writer and no critical section is
+ * needed.  N must be a power of two.
+ */
+#ifndef VD_RING_HPP_
+#define VD_RING_HPP_
+
+#include <stdint.h>
+#include "vd_barrier.h"
+
+template <typename T, int N>
+class vdRing
+{
+        /* compile error here means N is not a power of two */
+        typedef char vdRingSizeCheck[((N & (N - 1)) == 0) ? 1 : -1];
+
+    public:
+        vdRing() : mHead(0), mTail(0) { }
+
+        /** @returns false if the ring is full and @param value was dropped */
+        bool push(const T& value)
+        {
+            const uint32_t head = mHead;
+            if((head - mTail) >= (uint32_t) N) {
+                return false;
+            }
+            mBuf[head & (N - 1)] = value;
+            vdMemoryBarrier();
+            mHead = head + 1;
+            return true;
+        }
+
+        /** @returns false if the ring is empty */
+        bool pop(T& value)
+        {
+            const uint32_t tail = mTail;
+            if(tail == mHead) {
+                return false;
+            }
+            value = mBuf[tail & (N - 1)];
+            vdMemoryBarrier();
+            mTail = tail + 1;
+            return true;
+        }
+
+        inline uint32_t count(void) const { return mHead - mTail; }
+        inline uint32_t space(void) const { return N - count(); }
+        inline bool isEmpty(void) const { return mHead == mTail; }
+
+    private:
+        T mBuf[N];
+        volatile uint32_t mHead;    ///< Written by the producer only
+        volatile uint32_t mTail;    ///< Written by the consumer only
+};
+
+#endif /* VD_RING_HPP_ */
@@ -0,0 +1,149 @@
+/**
+ * @file
+ * @brief Decision table of the vd state machine, generated by the compiler from a rule list.
+ *
+ * Each sensor reading is classified once into a distance zone.  The next state,
+ * the speed to set and the sensor that becomes lastTarget are then a single
+ * load from vdTransition[], indexed by (state, left zone, middle zone, right
+ * zone, middle beyond targetDist).
+ *
+ * The rules are written in vdRule below, first match wins, exactly like the
+ * old switch in vdReadSensor().  vdRule<>::value is a constant expression, so
+ * the whole table is built at compile time and lives in flash.
+ * host/vd_rules_dump prints it as text to review or diff rule changes.
+ */
+#ifndef VD_RULES_HPP_
+#define VD_RULES_HPP_
+
+#include <stdint.h>
+
+/* state machine related types */
+enum vdStateId {
+    VD_ALARM,
+    VD_STOP,
+    VD_FWD,
+    VD_REV,
+    VD_FWD_LEFT,
+    VD_FWD_RIGHT,
+    VD_REV_LEFT,
+    VD_REV_RIGHT,
+    VD_TURN,
+    VD_NUM_STATES
+};
+
+enum vdSpeedId {
+    VD_HAULT,
+    VD_SLOW = 35,
+    VD_MEDIUM = 50,
+    VD_FAST = 70
+};
+
+/* distance zones of a reading in mm, the default bounds (vd_params.hpp) are where the old ADC count zones were */
+enum vdZoneId {
+    VD_ZONE_OUT_OF_RANGE,   ///< 761 ..
+    VD_ZONE_TOO_FAR,        ///< 441 .. 760
+    VD_ZONE_FAR,            ///< 261 .. 440
+    VD_ZONE_IN_RANGE,       ///< 111 .. 260
+    VD_ZONE_CLOSE,          ///<     .. 110
+    VD_NUM_ZONES
+};
+
+/** Classifies a distance with four compares against the descending @param bound instead of a divide per test */
+static inline int vdZoneOf(int mm, const int *bound)
+{
+    return (mm <= bound[0]) + (mm <= bound[1]) + (mm <= bound[2]) + (mm <= bound[3]);
+}
+
+/* what a decision does to the speed level and lastTarget, the speed level no longer drives the wheels since vdControl() does */
+enum { VD_KEEP_SPEED, VD_SET_SLOW, VD_SET_MEDIUM, VD_SET_FAST };
+enum { VD_KEEP_TARGET, VD_TARGET_LEFT, VD_TARGET_MIDDLE, VD_TARGET_RIGHT };
+
+/* a decision packed into one byte: next state, speed action and lastTarget source */
+#define VD_GO(state, speed, target)     ((state) | ((speed) << 4) | ((target) << 6))
+#define VD_DECISION_STATE(d)            ((d) & 0x0F)
+#define VD_DECISION_SPEED(d)            (((d) >> 4) & 0x03)
+#define VD_DECISION_TARGET(d)           (((d) >> 6) & 0x03)
+
+/**
+ * The rule list.  S is the current state, L/M/R the zones of the left, middle and
+ * right distances, and B is 1 if the middle distance is beyond targetDist.
+ * VD_ALARM is left alone here, it leaves by comparing against alarmTarget.
+ * The search states, VD_TURN standing still and VD_REV_LEFT/RIGHT spinning in
+ * place, end as soon as the middle sensor sees the target at any distance: one
+ * that waits for another zone turns past a far target, or ignores it for good.
+ */
+template <int S, int L, int M, int R, int B>
+struct vdRule
+{
+    enum {
+        lFar  = (L == VD_ZONE_FAR || L == VD_ZONE_TOO_FAR),
+        rFar  = (R == VD_ZONE_FAR || R == VD_ZONE_TOO_FAR),
+        lNear = (L == VD_ZONE_IN_RANGE || L == VD_ZONE_CLOSE),
+        rNear = (R == VD_ZONE_IN_RANGE || R == VD_ZONE_CLOSE),
+
+        value =
+        /*     state                 condition                                  next state      speed          lastTarget */
+        (S == VD_FWD) ?
+                ((M == VD_ZONE_FAR)                                   ? VD_GO(VD_FWD,       VD_SET_MEDIUM, VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_TOO_FAR && rFar)                       ? VD_GO(VD_FWD_RIGHT, VD_SET_FAST,   VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_TOO_FAR && lFar)                       ? VD_GO(VD_FWD_LEFT,  VD_SET_FAST,   VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_TOO_FAR)                               ? VD_GO(VD_FWD,       VD_SET_FAST,   VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_OUT_OF_RANGE)                          ? VD_GO(VD_TURN,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_IN_RANGE)                              ? VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                                                                        VD_GO(VD_FWD,       VD_KEEP_SPEED, VD_TARGET_MIDDLE)) :
+        (S == VD_REV) ?
+                ((M == VD_ZONE_CLOSE)                                 ? VD_GO(VD_REV,       VD_SET_SLOW,   VD_TARGET_MIDDLE) :
+                 (B)                                                  ? VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                                                                        VD_GO(VD_REV,       VD_KEEP_SPEED, VD_TARGET_MIDDLE)) :
+        (S == VD_TURN) ?
+                ((M != VD_ZONE_OUT_OF_RANGE)                          ? VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                 (rFar)                                               ? VD_GO(VD_FWD_RIGHT, VD_KEEP_SPEED, VD_TARGET_RIGHT) :
+                 (lFar)                                               ? VD_GO(VD_FWD_LEFT,  VD_KEEP_SPEED, VD_TARGET_LEFT) :
+                 (rNear)                                              ? VD_GO(VD_REV_LEFT,  VD_KEEP_SPEED, VD_TARGET_RIGHT) :
+                 (lNear)                                              ? VD_GO(VD_REV_RIGHT, VD_KEEP_SPEED, VD_TARGET_LEFT) :
+                                                                        VD_GO(VD_TURN,      VD_KEEP_SPEED, VD_KEEP_TARGET)) :
+        (S == VD_FWD_LEFT || S == VD_FWD_RIGHT) ?
+                ((M == VD_ZONE_FAR || M == VD_ZONE_IN_RANGE || M == VD_ZONE_CLOSE)
+                                                                      ? VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                                                                        VD_GO(S,            VD_KEEP_SPEED, VD_TARGET_MIDDLE)) :
+        (S == VD_REV_LEFT || S == VD_REV_RIGHT) ?
+                ((M != VD_ZONE_OUT_OF_RANGE)                          ? VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                                                                        VD_GO(S,            VD_KEEP_SPEED, VD_TARGET_MIDDLE)) :
+        (S == VD_ALARM) ?
+                                                                        VD_GO(VD_ALARM,     VD_KEEP_SPEED, VD_KEEP_TARGET) :
+        /* VD_STOP */
+                ((M == VD_ZONE_FAR || M == VD_ZONE_TOO_FAR || M == VD_ZONE_OUT_OF_RANGE)
+                                                                      ? VD_GO(VD_FWD,       VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                 (M == VD_ZONE_CLOSE)                                 ? VD_GO(VD_REV,       VD_KEEP_SPEED, VD_TARGET_MIDDLE) :
+                                                                        VD_GO(VD_STOP,      VD_KEEP_SPEED, VD_TARGET_MIDDLE))
+    };
+};
+
+/* expand vdRule<> over every (state, left, middle, right, beyond) in index order */
+#define VD_RULE_B(s, l, m, r)   vdRule<s, l, m, r, 0>::value, vdRule<s, l, m, r, 1>::value
+#define VD_RULE_R(s, l, m)      VD_RULE_B(s, l, m, 0), VD_RULE_B(s, l, m, 1), VD_RULE_B(s, l, m, 2), \
+                                VD_RULE_B(s, l, m, 3), VD_RULE_B(s, l, m, 4)
+#define VD_RULE_M(s, l)         VD_RULE_R(s, l, 0), VD_RULE_R(s, l, 1), VD_RULE_R(s, l, 2), \
+                                VD_RULE_R(s, l, 3), VD_RULE_R(s, l, 4)
+#define VD_RULE_L(s)            VD_RULE_M(s, 0), VD_RULE_M(s, 1), VD_RULE_M(s, 2), \
+                                VD_RULE_M(s, 3), VD_RULE_M(s, 4)
+
+static const uint8_t vdTransition[VD_NUM_STATES * VD_NUM_ZONES * VD_NUM_ZONES * VD_NUM_ZONES * 2] = {
+    VD_RULE_L(VD_ALARM),
+    VD_RULE_L(VD_STOP),
+    VD_RULE_L(VD_FWD),
+    VD_RULE_L(VD_REV),
+    VD_RULE_L(VD_FWD_LEFT),
+    VD_RULE_L(VD_FWD_RIGHT),
+    VD_RULE_L(VD_REV_LEFT),
+    VD_RULE_L(VD_REV_RIGHT),
+    VD_RULE_L(VD_TURN),
+};
+
+/** @returns the packed decision for the current state and zones, see VD_DECISION_*() */
+static inline uint8_t vdDecide(int state, int left, int middle, int right, bool beyondTarget)
+{
+    return vdTransition[(((state * VD_NUM_ZONES + left) * VD_NUM_ZONES + middle) * VD_NUM_ZONES + right) * 2 + beyondTarget];
+}
+
+#endif /* VD_RULES_HPP_ */
@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @brief Wait-free publication of a small struct from one writer task to any number of readers.
+ *
+ * The writer fills the slot after the one readers are currently pointed at and
+ * then publishes its sequence number, so it never waits on a reader.  A reader
+ * copies the latest slot and checks that the slot's sequence number did not
+ * change during the copy; it only retries if the writer lapped all SLOTS slots
+ * in the meantime, which cannot happen unless the reader was starved for
+ * SLOTS - 1 whole publish periods.  No mutex and no critical section is needed,
+ * so a higher priority reader that preempts the writer never blocks.
+ */
+#ifndef VD_SNAPSHOT_HPP_
+#define VD_SNAPSHOT_HPP_
+
+#include <stdint.h>
+#include <string.h>
+#include "vd_barrier.h"
+
+template <typename T, int SLOTS = 4>
+class vdSnapshot
+{
+    public:
+        vdSnapshot() : mLatest(0)
+        {
+            for(int i = 0; i < SLOTS; i++) {
+                mSlot[i].seq = 0;
+            }
+        }
+
+        /**
+         * Publishes @param value (single writer only)
+         * @returns the sequence number given to it, starting at 1
+         */
+        uint32_t publish(const T& value)
+        {
+            uint32_t seq = mLatest + 1;
+            if(seq == 0) {
+                seq = 1; // 0 is reserved for "nothing published"
+            }
+            slot_t *s = &mSlot[seq % SLOTS];
+
+            s->seq = 0;             // readers of this slot will retry from here on
+            vdMemoryBarrier();
+            memcpy(&s->data, &value, sizeof(T));
+            vdMemoryBarrier();
+            s->seq = seq;
+            vdMemoryBarrier();
+            mLatest = seq;
+
+            return seq;
+        }
+
+        /**
+         * Copies the latest published value to @param out
+         * @returns its sequence number, or 0 if nothing has been published yet
+         */
+        uint32_t read(T& out) const
+        {
+            for(;;) {
+                const uint32_t latest = mLatest;
+                if(0 == latest) {
+                    return 0;
+                }
+
+                const slot_t *s = &mSlot[latest % SLOTS];
+                const uint32_t before = s->seq;
+                vdMemoryBarrier();
+                memcpy(&out, (const void*) &s->data, sizeof(T));
+                vdMemoryBarrier();
+                if(before != 0 && before == s->seq) {
+                    return before;
+                }
+            }
+        }
+
+        /** @returns the sequence number of the latest value, to skip work if it did not move */
+        inline uint32_t sequence(void) const { return mLatest; }
+
+    private:
+        typedef struct {
+            volatile uint32_t seq;  ///< Sequence number of data, 0 while being written
+            T data;
+        } slot_t;
+
+        slot_t mSlot[SLOTS];
+        volatile uint32_t mLatest;  ///< Sequence number of the newest complete slot
+};
+
+#endif /* VD_SNAPSHOT_HPP_ */
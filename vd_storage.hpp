@@ -0,0 +1,152 @@
+/**
+ * @file
+ * @brief Rotating flight recorder log files on the SD card.
+ *
+ * Files are named after VD_STORAGE_PATH and used in turn: generation g goes to
+ * file g % VD_LOG_FILES, and after a reboot the next generation follows the
+ * newest one found on the card.  A new file is preallocated to VD_LOG_FILE_BYTES,
+ * so appending never has to search the FAT for free clusters and every write
+ * costs about the same.  FatFs takes the SPI #1 semaphore (spi_sem.h) around
+ * every card access, so the flash and other SD users stay arbitrated.
+ *
+ * The vd parameters are kept in the "disk" telemetry instead, see
+ * vdStorageRegisterParams().
+ *
+ * Part of the SJOne backend, include through vd_hal.h only.
+ */
+#ifndef VD_STORAGE_HPP_
+#define VD_STORAGE_HPP_
+
+#include <stdio.h>
+#include <string.h>
+#include "ff.h"
+#include "sys_config.h"
+#include "tlm/c_tlm_comp.h"
+#include "tlm/c_tlm_var.h"
+#include "vd_recorder.hpp"
+
+#define VD_STORAGE_PATH         "1:vdlog%d.bin" ///< Drive 1 is the SD card, 0 would be the SPI flash
+#define VD_CALIBRATION_PATH     "1:vdcal.bin"   ///< Written by host/vd_cal_gen, see vd_calibration.hpp
+
+static FIL storageFile;
+static bool storageOpen = false;
+
+/** @returns the generation of log file @param index, 0 if there is none */
+static uint32_t vdStorageGeneration(int index)
+{
+    char path[16];
+    FIL file;
+    UINT bytes = 0;
+    vdLogHeader header;
+    bool valid;
+
+    snprintf(path, sizeof(path), VD_STORAGE_PATH, index);
+    if(FR_OK != f_open(&file, path, FA_READ)) {
+        return 0;
+    }
+    valid = (FR_OK == f_read(&file, &header, sizeof(header), &bytes)) && bytes == sizeof(header) &&
+            0 == memcmp(header.magic, VD_LOG_MAGIC, sizeof(VD_LOG_MAGIC));
+    f_close(&file);
+
+    return valid ? header.generation : 0;
+}
+
+static bool vdStorageOpen(uint32_t& generation)
+{
+    static uint32_t lastGeneration = 0;
+    char path[16];
+    int i;
+
+    if(storageOpen) {
+        f_close(&storageFile);
+        storageOpen = false;
+    }
+
+    /* carry on after the newest file left on the card by the previous runs */
+    if(0 == lastGeneration) {
+        for(i = 0; i < VD_LOG_FILES; i++) {
+            const uint32_t g = vdStorageGeneration(i);
+            if(g > lastGeneration) {
+                lastGeneration = g;
+            }
+        }
+    }
+
+    const uint32_t next = lastGeneration + 1;
+    snprintf(path, sizeof(path), VD_STORAGE_PATH, (int)(next % VD_LOG_FILES));
+    if(FR_OK != f_open(&storageFile, path, FA_WRITE | FA_CREATE_ALWAYS)) {
+        return false;
+    }
+
+    /* seeking past the end of a file open for writing allocates the clusters up front */
+    if(FR_OK != f_lseek(&storageFile, VD_LOG_FILE_BYTES) || f_tell(&storageFile) != VD_LOG_FILE_BYTES ||
+       FR_OK != f_lseek(&storageFile, 0)) {
+        f_close(&storageFile);
+        return false;
+    }
+
+    storageOpen = true;
+    lastGeneration = next;
+    generation = next;
+    return true;
+}
+
+static bool vdStorageWrite(uint32_t offset, const void *data, int len, bool sync)
+{
+    UINT bytes = 0;
+
+    if(!storageOpen) {
+        return false;
+    }
+    /*
+     * the file is preallocated, so seeking anywhere in it is cheap.  f_sync() after
+     * every chunk so a power cycle loses at most the chunk being collected
+     */
+    if(FR_OK != f_lseek(&storageFile, offset) || FR_OK != f_write(&storageFile, data, len, &bytes) ||
+       bytes != (UINT) len || (sync && FR_OK != f_sync(&storageFile))) {
+        f_close(&storageFile);
+        storageOpen = false;
+        return false;
+    }
+    return true;
+}
+
+static bool vdStorageReadCalibration(void *data, int len)
+{
+    FIL file;
+    UINT bytes = 0;
+    bool ok;
+
+    if(FR_OK != f_open(&file, VD_CALIBRATION_PATH, FA_READ)) {
+        return false;
+    }
+    ok = (FR_OK == f_read(&file, data, len, &bytes)) && bytes == (UINT) len;
+    f_close(&file);
+
+    return ok;
+}
+
+/**
+ * Adds the values to the "disk" telemetry, by name.  The scheduler restores
+ * them from the disk after regTlm() and terminalTask saves them whenever they
+ * changed, so a value missing from the disk simply keeps its initial one.
+ */
+static bool vdStorageRegisterParams(int *values, const char * const *names, int count)
+{
+#if ENABLE_TELEMETRY
+    tlm_component *disk = tlm_component_get_by_name(SYS_CFG_DISK_TLM_NAME);
+    int i;
+
+    for(i = 0; i < count; i++) {
+        if(!disk || !tlm_variable_register(disk, names[i], &values[i], sizeof(values[i]), 1, tlm_int)) {
+            return false;
+        }
+    }
+    return true;
+#else
+    /* nothing to register, the initial values are used at every boot */
+    return true;
+#endif
+}
+
+#endif /* VD_STORAGE_HPP_ */
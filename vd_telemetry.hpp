@@ -0,0 +1,73 @@
+/**
+ * @file
+ * @brief Fixed-size binary telemetry frame streamed to the phone over Bluetooth.
+ *
+ * Frame layout (16 bytes, multi-byte fields are little endian) :
+ * @code
+ *     0      sync 0xA5
+ *     1      length of bytes 2..13 (12)
+ *     2..3   sequence number of the sensor reading
+ *     4..7   timestamp in ticks (ms)
+ *     8..12  left:12 | middle:12 << 12 | right:12 << 24 | state:4 << 36, distances in mm
+ *     13     duty on the faster wheel (PWM percent)
+ *     14..15 CRC-16/CCITT (0xFFFF seed) of bytes 1..13
+ * @endcode
+ */
+#ifndef VD_TELEMETRY_HPP_
+#define VD_TELEMETRY_HPP_
+
+#include <stdint.h>
+
+static const uint8_t VD_TLM_SYNC = 0xA5;
+static const int VD_TLM_FRAME_LEN = 16;
+
+/** CRC-16/CCITT, nibble table to keep flash usage at 32 bytes */
+static uint16_t vdCrc16(const uint8_t *data, int len)
+{
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    uint16_t crc = 0xFFFF;
+
+    while(len--) {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (*data >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (*data & 0x0F)];
+        data++;
+    }
+    return crc;
+}
+
+/**
+ * Encodes one telemetry frame into @param frame (VD_TLM_FRAME_LEN bytes)
+ * @returns the number of bytes to send
+ */
+static inline int vdTelemetryEncode(uint8_t *frame, uint32_t seq, uint32_t timestamp,
+                             int left, int middle, int right, int state, int speed)
+{
+    const uint32_t lm = (left & 0xFFF) | ((middle & 0xFFF) << 12) | ((right & 0xFF) << 24);
+    const uint8_t rs = ((right >> 8) & 0x0F) | ((state & 0x0F) << 4);
+
+    frame[0] = VD_TLM_SYNC;
+    frame[1] = VD_TLM_FRAME_LEN - 4;
+    frame[2] = seq;
+    frame[3] = seq >> 8;
+    frame[4] = timestamp;
+    frame[5] = timestamp >> 8;
+    frame[6] = timestamp >> 16;
+    frame[7] = timestamp >> 24;
+    frame[8] = lm;
+    frame[9] = lm >> 8;
+    frame[10] = lm >> 16;
+    frame[11] = lm >> 24;
+    frame[12] = rs;
+    frame[13] = speed;
+
+    const uint16_t crc = vdCrc16(&frame[1], 13);
+    frame[14] = crc;
+    frame[15] = crc >> 8;
+
+    return VD_TLM_FRAME_LEN;
+}
+
+#endif /* VD_TELEMETRY_HPP_ */
@@ -0,0 +1,243 @@
+/**
+ * @file
+ * @brief terminalTask commands of the vd subsystem, declared in vd_commons.h.
+ */
+#ifndef VD_TERMINAL_HPP_
+#define VD_TERMINAL_HPP_
+
+#include <malloc.h>
+#include "command_handler.hpp"
+#include "FreeRTOS.h"
+#include "task.h"
+
+CMD_HANDLER_FUNC(vdProfileHandler)
+{
+    int i;
+
+    if(cmdParams == "reset") {
+        vdProfileReset();
+        executive.reset();
+        output.printf("vd profile counters cleared\n");
+        return true;
+    }
+
+#if VD_ENABLE_PROFILING
+    output.printf("%-10s %8s %8s %8s %8s %8s  (CPU cycles)\n", "stage", "count", "min", "p50", "p99", "max");
+    for(i = 0; i < VD_PROF_STAGES; i++) {
+        const vdProfileStats *s = &vdProfile[i];
+        if(0 == s->count) {
+            output.printf("%-10s %8u\n", vdProfileStageNames[i], 0);
+            continue;
+        }
+        output.printf("%-10s %8u %8u %8u %8u %8u\n", vdProfileStageNames[i], (unsigned) s->count, (unsigned) s->min,
+                      (unsigned) vdProfilePercentile(s, 50), (unsigned) vdProfilePercentile(s, 99), (unsigned) s->max);
+    }
+#else
+    output.printf("vd profiling is compiled out, set VD_ENABLE_PROFILING to 1\n");
+#endif
+
+#if VD_CYCLIC_EXECUTIVE
+    /* slots of the cyclic executive against their budgets */
+    const uint32_t perUs = vdHalCyclesPerUs();
+    output.printf("\n%-10s %6s %6s %8s %8s %8s  (us)\n", "slot", "period", "budget", "runs", "max", "overruns");
+    for(i = 0; i < VD_SLOTS; i++) {
+        const vdSlot& slot = executive.slot(i);
+        const vdSlotStats& s = executive.stats(i);
+        output.printf("%-10s %6u %6u %8u %8u %8u\n", slot.name, slot.periodMs, slot.budgetUs, (unsigned) s.runs,
+                      (unsigned)(s.maxCycles / perUs), (unsigned) s.overruns);
+    }
+    output.printf("%-10s %6s %6u %8u %8u %8u\n", "frame", "", (unsigned) executive.frameUs(), (unsigned) executive.frames(),
+                  (unsigned)(executive.maxFrameCycles() / perUs), (unsigned) executive.frameOverruns());
+#endif
+
+#if (configGENERATE_RUN_TIME_STATS && configUSE_TRACE_FACILITY)
+    /* CPU share of every task since boot, from FreeRTOS run-time stats */
+    TaskStatus_t status[16];
+    uint32_t total = 0;
+    const UBaseType_t count = uxTaskGetSystemState(status, sizeof(status) / sizeof(status[0]), &total);
+
+    total /= 100;
+    if(total > 0) {
+        output.printf("\n%-16s %5s\n", "task", "%cpu");
+        for(i = 0; i < (int) count; i++) {
+            output.printf("%-16s %5u\n", status[i].pcTaskName, (unsigned)(status[i].ulRunTimeCounter / total));
+        }
+    }
+#endif
+
+    return true;
+}
+
+CMD_HANDLER_FUNC(vdLogHandler)
+{
+    static const char * const stateNames[] = { "ALARM", "STOP", "FWD", "REV", "FWD_L", "FWD_R", "REV_L", "REV_R", "TURN" };
+    vdFlightRecord recs[16];
+    uint32_t lost = 0, total = 0;
+    int i, n;
+
+    if(cmdParams == "sd") {
+        output.printf("file generation %u, chunk %u of %u\n", (unsigned) logGeneration, (unsigned) logChunkIndex,
+                      (unsigned)(VD_LOG_FILE_BYTES / VD_LOG_CHUNK_BYTES));
+        output.printf("%u writes, slowest %u ms, %u blocks lost\n", (unsigned) logWrites, (unsigned) logMaxWriteMs,
+                      (unsigned) logLost);
+        return true;
+    }
+
+    /* drains in small chunks, the recorder keeps running while this prints */
+    do {
+        n = flightRecorder.drain(recs, sizeof(recs) / sizeof(recs[0]), &lost);
+        for(i = 0; i < n; i++) {
+            const vdFlightRecord *r = &recs[i];
+            output.printf("%10u %4u %4u %4u %-5s %3u%s\n", (unsigned) r->timestamp, r->left, r->middle, r->right,
+                          (r->state < VD_NUM_STATES) ? stateNames[r->state] : "?", r->speed,
+                          (r->flags & VD_REC_PAUSED) ? " paused" : "");
+        }
+        total += n;
+    } while(n == sizeof(recs) / sizeof(recs[0]));
+
+    output.printf("%u records", (unsigned) total);
+    if(lost) {
+        output.printf(", %u blocks overwritten before they were read", (unsigned) lost);
+    }
+    output.printf("\n");
+    return true;
+}
+
+CMD_HANDLER_FUNC(vdParamHandler)
+{
+    vdParams p;
+    const char *s = cmdParams.c_str();
+    char name[24];
+    int value, used, i, bad;
+
+    /* the last published set, what the control path runs with from its next tick */
+    if(0 == paramsNext.read(p)) {
+        p = params;
+    }
+
+    if(cmdParams == "save") {
+        paramsSaved = p;
+        output.printf("vd parameters saved to disk telemetry\n");
+        return true;
+    }
+    if(cmdParams == "default") {
+        vdParamsPublish(&VD_PARAMS_DEFAULT);
+        output.printf("vd parameters set to the defaults, 'vdparam save' to keep them\n");
+        return true;
+    }
+
+    if(0 == cmdParams.getLen()) {
+        output.printf("%-12s %6s %6s %7s\n", "name", "value", "saved", "default");
+        for(i = 0; i < VD_PARAMS_COUNT; i++) {
+            output.printf("%-12s %6d %6d %7d\n", vdParamNames[i], ((const int*) &p)[i], ((const int*) &paramsSaved)[i],
+                          ((const int*) &VD_PARAMS_DEFAULT)[i]);
+        }
+        return true;
+    }
+
+    /* every pair is checked and applied together, so related values can change in one step */
+    while(2 == sscanf(s, "%23s %d%n", name, &value, &used)) {
+        for(i = 0; i < VD_PARAMS_COUNT && 0 != strcmp(name, vdParamNames[i]); i++) {
+        }
+        if(i == VD_PARAMS_COUNT) {
+            output.printf("unknown vd parameter %s\n", name);
+            return false;
+        }
+        ((int*) &p)[i] = value;
+        s += used;
+    }
+    while(' ' == *s) {
+        s++;
+    }
+    if(*s) {
+        output.printf("expected <name> <value> pairs at '%s'\n", s);
+        return false;
+    }
+    if((bad = vdParamsCheck(&p)) >= 0) {
+        output.printf("%s = %d is out of range with the other values, nothing changed\n", vdParamNames[bad],
+                      ((const int*) &p)[bad]);
+        return false;
+    }
+    vdParamsPublish(&p);
+    output.printf("vd parameters applied, 'vdparam save' to keep them\n");
+    return true;
+}
+
+/* declared stack of every vd task, by FreeRTOS task name */
+static const vdRamUse vdStacks[] = {
+    { "vdStartup",      VD_STACK_STARTUP },
+    { "vdSensor",       VD_STACK_SENSOR },
+    { "vdMotor",        VD_STACK_MOTOR },
+    { "vdIndicator",    VD_STACK_INDICATOR },
+    { "vdBluetoothRx",  VD_STACK_BT_RX },
+    { "vdBluetoothTx",  VD_STACK_BT_TX },
+    { "vdLogger",       VD_STACK_LOGGER },
+    { "vdExecutive",    VD_STACK_EXECUTIVE },
+};
+
+/*
+ * A high-water mark only covers the paths taken since boot, a printf the dog
+ * has not hit yet or a card error can go deeper, so the recommended size keeps
+ * a quarter of the measured use on top, at least VD_STACK_MARGIN_MIN.
+ */
+static const uint32_t VD_STACK_MARGIN_MIN = 256;
+static const uint32_t VD_STACK_ALIGN = 64;
+
+/** @returns the stack bytes to give a task that has used @param used of its stack so far */
+static uint32_t vdStackRecommended(uint32_t used)
+{
+    const uint32_t margin = (used / 4 > VD_STACK_MARGIN_MIN) ? used / 4 : VD_STACK_MARGIN_MIN;
+    return (used + margin + VD_STACK_ALIGN - 1) / VD_STACK_ALIGN * VD_STACK_ALIGN;
+}
+
+CMD_HANDLER_FUNC(vdMemHandler)
+{
+    const vdRamUse *hal;
+    const int halCount = vdHalRam(&hal);
+    uint32_t total = 0;
+    int i, j;
+
+#if configUSE_TRACE_FACILITY
+    /* FreeRTOS fills every stack with a pattern at creation, the high-water mark is the part left untouched */
+    TaskStatus_t status[16];
+    const UBaseType_t count = uxTaskGetSystemState(status, sizeof(status) / sizeof(status[0]), NULL);
+    int spare = 0;
+
+    output.printf("%-16s %6s %6s %6s %6s\n", "task", "stack", "used", "free", "rec");
+    for(i = 0; i < (int) count; i++) {
+        const uint32_t unused = status[i].usStackHighWaterMark * sizeof(StackType_t);
+        for(j = 0; j < (int)(sizeof(vdStacks) / sizeof(vdStacks[0])) && 0 != strcmp(status[i].pcTaskName, vdStacks[j].name); j++) {
+        }
+        if(j == sizeof(vdStacks) / sizeof(vdStacks[0])) {
+            /* not a vd task, only the free part is known */
+            output.printf("%-16s %6s %6s %6u\n", status[i].pcTaskName, "", "", (unsigned) unused);
+            continue;
+        }
+        const uint32_t used = vdStacks[j].bytes - unused;
+        const uint32_t rec = vdStackRecommended(used);
+        output.printf("%-16s %6u %6u %6u %6u\n", status[i].pcTaskName, (unsigned) vdStacks[j].bytes, (unsigned) used,
+                      (unsigned) unused, (unsigned) rec);
+        spare += (int) vdStacks[j].bytes - (int) rec;
+    }
+    output.printf("vd stacks at the recommended sizes would save %d bytes\n", spare);
+#else
+    output.printf("vd stack marks need configUSE_TRACE_FACILITY set to 1\n");
+#endif
+
+    /* static RAM by module, the vd code first and then the backend */
+    output.printf("\n%-16s %6s\n", "module", "bytes");
+    for(i = 0; i < VD_RAM_MODULES + halCount; i++) {
+        const vdRamUse *m = (i < VD_RAM_MODULES) ? &vdRamModules[i] : &hal[i - VD_RAM_MODULES];
+        output.printf("%-16s %6u\n", m->name, (unsigned) m->bytes);
+        total += m->bytes;
+    }
+    output.printf("%-16s %6u\n", "total", (unsigned) total);
+
+    /* the task stacks and FreeRTOS objects come from the malloc heap */
+    const struct mallinfo heap = mallinfo();
+    output.printf("\nheap: %u bytes in use, %u free of %u\n", (unsigned) heap.uordblks, (unsigned) heap.fordblks,
+                  (unsigned) heap.arena);
+    return true;
+}
+
+#endif /* VD_TERMINAL_HPP_ */
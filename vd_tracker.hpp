@@ -0,0 +1,158 @@
+/**
+ * @file
+ * @brief Fixed-point alpha-beta tracker of the target's range and bearing.
+ *
+ * Every sample, converted to mm, is fused into two measurements :
+ *  - range, the nearest of the distances, since it is the target's distance
+ *    whichever beam the target is in;
+ *  - bearing, the centroid across the beams of how much closer than the floor
+ *    each distance is, from -VD_BEARING_SPAN (leftmost beam only) to
+ *    +VD_BEARING_SPAN (rightmost beam only).
+ *
+ * Each is smoothed by an alpha-beta filter, a steady-state Kalman filter for a
+ * constant velocity target, which also estimates its rate.  Unlike the running
+ * median it has no window: one update is a few multiplies and one divide.  Each
+ * sample is compared with where the rate says the target should be, and one
+ * further than the gate from there is dropped as a spike, unless enough of them
+ * in a row show that the target really jumped.  The range rate damps the
+ * distance loop, see vdControl().
+ *
+ * The rates are per sample period whatever the sample rate: a sample that comes
+ * several periods after the previous one is predicted that far ahead, and the
+ * rate correction is spread over the gap.
+ */
+#ifndef VD_TRACKER_HPP_
+#define VD_TRACKER_HPP_
+
+#include <stdint.h>
+
+static const int VD_BEARING_SPAN = 1024;
+
+/**
+ * One alpha-beta filter in Q8 fixed point, with ALPHA and BETA in 1/256.
+ * The rate is in units per sample.
+ */
+template <int ALPHA, int BETA, int GATE>
+class vdAlphaBeta
+{
+    public:
+        vdAlphaBeta() : mX(0), mV(0), mOutliers(0), mValid(false) { }
+
+        /** Starts over from @param z at rest */
+        void reset(int z)
+        {
+            mX = z * 256;
+            mV = 0;
+            mOutliers = 0;
+            mValid = true;
+        }
+
+        /** Advances @param periods samples and corrects with measurement @param z */
+        void update(int z, int periods = 1)
+        {
+            if(!mValid) {
+                reset(z);
+                return;
+            }
+
+            mX += mV * periods;
+            const int32_t r = z * 256 - mX;
+            if(r > (GATE << 8) || r < -(GATE << 8)) {
+                /* a spike, unless it persists */
+                if(++mOutliers < VD_TRACK_OUTLIERS) {
+                    return;
+                }
+                reset(z);
+                return;
+            }
+            mOutliers = 0;
+            mX += (ALPHA * r) >> 8;
+            mV += ((BETA * r) >> 8) / periods;
+        }
+
+        /** Advances @param periods samples without a measurement */
+        inline void coast(int periods = 1) { mX += mV * periods; }
+
+        inline void invalidate(void) { mValid = false; }
+
+        inline int value(void) const { return mX >> 8; }
+        inline int rate(void) const { return mV >> 8; }   ///< Per sample, truncated
+
+        /** @returns the rate per second, for a sample rate of @param hz */
+        inline int ratePerSecond(int hz) const { return (mV * hz) >> 8; }
+
+    private:
+        static const int VD_TRACK_OUTLIERS = 3; ///< That many gated samples in a row restart the filter
+
+        int32_t mX;         ///< Q8
+        int32_t mV;         ///< Q8 per sample
+        int mOutliers;
+        bool mValid;
+};
+
+/**
+ * Fuses N channels numbered from the leftmost one, FLOOR is the distance in mm
+ * beyond which a channel does not see the target and COAST the number of
+ * samples the tracker keeps predicting without seeing it.
+ */
+template <int N, int FLOOR, int COAST>
+class vdTracker
+{
+    public:
+        vdTracker() : mMissed(COAST)
+        {
+            /* the beams spread evenly across the bearing span */
+            for(int c = 0; c < N; c++) {
+                mBeam[c] = (2 * c - (N - 1)) * VD_BEARING_SPAN / (N - 1);
+            }
+        }
+
+        /** @param mm is the distance of every channel, @param periods after the previous sample */
+        void update(const int *mm, int periods = 1)
+        {
+            int nearest = mm[0];
+            int sum = 0, moment = 0;
+
+            for(int c = 0; c < N; c++) {
+                const int w = (mm[c] < FLOOR) ? FLOOR - mm[c] : 0;
+                sum += w;
+                moment += w * mBeam[c];
+                nearest = (mm[c] < nearest) ? mm[c] : nearest;
+            }
+
+            if(0 == sum) {
+                if(mMissed < COAST) {
+                    mMissed += periods;
+                    mRange.coast(periods);
+                    mBearing.coast(periods);
+                }
+                else {
+                    mRange.invalidate();
+                    mBearing.invalidate();
+                }
+                return;
+            }
+            mMissed = 0;
+
+            mRange.update(nearest, periods);
+            mBearing.update(moment / sum, periods);
+        }
+
+        /** @returns true while the target is seen, or was seen less than COAST samples ago */
+        inline bool tracking(void) const { return mMissed < COAST; }
+
+        inline int range(void) const { return mRange.value(); }
+        inline int bearing(void) const { return mBearing.value(); }
+        inline int rangeRate(int hz) const { return mRange.ratePerSecond(hz); }
+        inline int bearingRate(int hz) const { return mBearing.ratePerSecond(hz); }
+
+    private:
+        typedef char vdTrackerChannelCheck[(N >= 2) ? 1 : -1];
+
+        vdAlphaBeta<32, 2, 150> mRange;     ///< mm, a step of the target is a few tens
+        vdAlphaBeta<64, 6, 900> mBearing;   ///< Crossing into a side beam is a legitimate jump of ~700
+        int mMissed;                        ///< Sample periods since a channel last saw the target
+        int mBeam[N];                       ///< Bearing of each channel
+};
+
+#endif /* VD_TRACKER_HPP_ */